@@ -43,6 +43,7 @@ typedef unsigned long HASHCODE;
 typedef unsigned long* NNF_NODE;
 typedef struct nnf Nnf;
 typedef struct nnf_manager NnfManager;
+typedef struct nnf_evaluator_t NnfEvaluator; //see evaluator.c
 
 /******************************************************************************
  * typedefs for sat_api 
@@ -77,8 +78,51 @@ typedef struct {
   BOOLEAN count_models;  //count the models of the output nnf
   BOOLEAN model_counter; //only (weighted) model counter
   BOOLEAN help;          //help
+
+  //counting
+  int tt_vars;           //max free variables of a vtree counted by truth tables (0 disables)
+
+  //clause learning
+  int chronological;     //backjumps over more levels backtrack one level instead (0 disables)
+
+  //cache spilling
+  char* spill_filename;  //file to which cold cache entries are spilled (NULL if none)
+  int cache_memory;      //memory (in MB) for cache entries before they are spilled
+  BOOLEAN compress_keys; //compress the keys of cache entries that were not hit recently
+  int cube_vars;         //number of top Shannon variables to split on when model counting (0 disables)
+  int workers;           //number of worker processes counting cubes (0 counts them in this process)
+  BOOLEAN deterministic; //workers count fixed sequences of cubes (for reproducible runs)
+
+  //approximate counting
+  BOOLEAN approx;        //approximate the model count by hashing
+  double epsilon;        //tolerance of approximate count
+  double delta;          //confidence of approximate count is 1-delta
+
+  //projected counting
+  BOOLEAN projected;     //count models projected onto the variables of c ind (or c projection) lines
+
+  //bounded counting
+  double threshold;      //stop counting once the count reaches threshold (0 disables)
+
+  //anytime bounds
+  int bounds_interval;   //seconds between reports of bounds on the count while counting (0 disables)
+
+  //semiring of model counting
+  char semiring;         //s: sum-product, m: max-product (most probable explanation), l: log-space
+
+  //sdd output
+  char* sdd_out_filename; //output sdd file of the compiled nnf (its vtree is saved to sdd_out_filename.vtree)
+
+  //incremental evaluation
+  char* weight_updates_filename; //weight updates under which the compiled nnf is evaluated
 } c2dOptions;
 
+//truth tables of up to 2^TT_MAX_VARS bits
+#define TT_MAX_VARS 12
+
+//at most 2^MAX_CUBE_VARS cubes when splitting on top Shannon variables
+#define MAX_CUBE_VARS 24
+
 /******************************************************************************
  * Structure clause/variable sets
  ******************************************************************************/
@@ -126,6 +170,39 @@ typedef struct decision_vtree_t {
   struct vtree_cache_entry_t* cache_entry;
 } DVtree;
 
+/******************************************************************************
+ * Structure for flattened vtree
+ ******************************************************************************/
+
+//flags of flattened vtree nodes
+#define FV_LEAF    1 //leaf vtree node
+#define FV_SHANNON 2 //Shannon vtree node (its left child is a leaf)
+#define FV_CACHE   4 //Shannon vtree node whose cache is live
+#define FV_PROJECTED 8 //vtree node with projection variables (projected counting only)
+
+//the nodes of a vtree stored contiguously in DFS (preorder), one cache line each
+//
+//the left child of an internal node immediately follows it, and a vtree node with
+//n variables spans 2n-1 consecutive entries (the last of which is a leaf)
+typedef struct flat_vtree_t {
+  DVtree* vtree;       //the vtree node
+  Var* var;            //variable of a leaf, or Shannon variable of a Shannon node
+  unsigned int left;   //offset of left child from this entry
+  unsigned int right;  //offset of right child from this entry
+  c2dSize var_count;   //number of variables in vtree
+  BYTE flags;          //see above
+} __attribute__((aligned(64))) FVtree;
+
+#define FV_LEFT(node)       ((node)+(node)->left)
+#define FV_RIGHT(node)      ((node)+(node)->right)
+#define FV_END(node)        ((node)+2*(node)->var_count-1)
+#define FV_IS_LEAF(node)    ((node)->flags&FV_LEAF)
+#define FV_IS_SHANNON(node) ((node)->flags&FV_SHANNON)
+#define FV_IS_PROJECTED(node) ((node)->flags&FV_PROJECTED)
+
+//which vtree nodes to cache at: CRITICAL to performance
+#define FV_SHOULD_CACHE(node) (((node)->flags&FV_CACHE) && !sat_instantiated_var((node)->var))
+
 /******************************************************************************
  * Structures for vtree cache
  ******************************************************************************/
@@ -135,28 +212,99 @@ typedef union vtree_cache_value_t {
   NNF_NODE node;  //to cache nnf nodes
 } VtreeCV;
  
+//a cache entry (16 bytes), stored in the hash table itself
 typedef struct vtree_cache_entry_t {
-  DVtree* vtree;  //the vtree node that generated this entry
-  BYTE* key;      //a pointer to the starting cell where the key is stored
-  VtreeCV value;  //the value to which the key is mapped
-
-  //a pointer to the next cache entry in the same collision list
-  struct vtree_cache_entry_t* next;
-
-  //keeping track of prev entry in collision list
-  struct vtree_cache_entry_t** prev_next; 
-
-  //a pointer to the next cache entry in the list of cache entries for a given vtree
-  struct vtree_cache_entry_t* vtree_next;
+  unsigned int vtree; //1+position of the vtree node that generated this entry (see below)
+  unsigned int key;   //offset of the key record of this entry in the key arena (in cells)
+  VtreeCV value;      //the value to which the key is mapped
 } VtreeCE;
 
+//values of the vtree field of empty and deleted hash table slots
+#define VTREE_CE_EMPTY   0
+#define VTREE_CE_DELETED 0xFFFFFFFFU
+//bit of the vtree field set when an entry is inserted or hit (for aging entries)
+#define VTREE_CE_REFERENCED 0x80000000U
+
+#define VTREE_CE_LIVE(entry)     ((entry)->vtree!=VTREE_CE_EMPTY && (entry)->vtree!=VTREE_CE_DELETED)
+#define VTREE_CE_POSITION(entry) (((entry)->vtree&~VTREE_CE_REFERENCED)-1)
+
+//header of a key record in the key arena (one cell), followed by the key itself
+//
+//the key records of a vtree node are chained, so they can be dropped together
+typedef struct vtree_key_header_t {
+  unsigned int vtree_next; //1+offset of the next key record of the same vtree node (0 if none)
+  unsigned int slot;       //hash table slot of the entry owning the key
+} VtreeKH;
+
+//slot of a key record that is no longer used (its vtree_next is then its size in cells)
+#define VTREE_KH_DEAD 0xFFFFFFFFU
+//bit of the slot of a key record whose entry was spilled (the slot is then the position
+//of its vtree node, and the record is still chained)
+#define VTREE_KH_SPILLED 0x80000000U
+//bit of the slot of a key record whose key is compressed (see cache.c)
+#define VTREE_KH_PACKED  0x40000000U
+
+#define VTREE_KH_SLOT(header) ((header)->slot&~(VTREE_KH_SPILLED|VTREE_KH_PACKED))
+
+//an entry of the fingerprint index of spilled cache entries
+typedef struct vtree_spill_index_t {
+  unsigned long fingerprint; //fingerprint of vtree node, its generation and key (0: empty, 1: deleted)
+  unsigned long offset;      //offset of the spilled entry in the spill file
+  unsigned int position;     //position of the vtree node of the entry
+  unsigned int generation;   //generation of the vtree node when the entry was spilled
+} VtreeSI;
+
+//a second cache tier: cache entries spilled to an append-only file
+typedef struct {
+  char* filename;
+  FILE* file;
+  c2dSize size;               //bytes written to file
+  VtreeSI* index;             //fingerprint index (open addressing with linear probing)
+  c2dSize capacity;           //the total number of slots in index
+  c2dSize count;              //the number of spilled entries in index (of current generations)
+  c2dSize deleted;            //the number of deleted slots in index
+  c2dSize stale;              //the number of slots in index of entries of older generations
+  BYTE* bloom;                //bloom filter of the fingerprints in index
+  c2dSize bloom_bits;
+  c2dSize vtree_count;
+  unsigned int* generations;  //generations[p] is incremented when the entries of vtree node at position p are dropped
+  c2dSize* counts;            //counts[p] is the number of spilled entries in index of vtree node at position p
+  BYTE* key;                  //space for reading the largest key
+  c2dSize spills;             //the number of entries spilled
+  c2dSize hits;               //the number of entries found (and promoted)
+  c2dSize reads;              //the number of entries read from file
+  c2dSize filtered;           //the number of lookups rejected by the bloom filter
+} VtreeSpill;
+
 typedef struct {
-  c2dSize capacity;  //the total number of buckets (collision lists) in cache
-  VtreeCE** buckets; //the array where cache buckets are stored
+  c2dSize capacity;  //the total number of slots in hash table
+  VtreeCE* table;    //hash table (open addressing with linear probing)
   c2dSize count;     //the number of entries currently in cache
-  c2dSize memory;    //the memory (in bytes) used to store cache entries
+  c2dSize deleted;   //the number of deleted slots in hash table
+  c2dSize memory;    //the memory (in bytes) used to store cache entries and their keys
   c2dSize hits;      //the number of cache hits
   c2dSize misses;    //the number of cache misses
+  c2dSize probes;    //the number of slots visited by lookups
+
+  //key arena
+  VtreeKH* keys;        //key records, in cells of sizeof(VtreeKH) bytes
+  c2dSize key_capacity; //cells allocated
+  c2dSize key_used;     //cells used by key records (live or dead)
+  c2dSize key_garbage;  //cells used by dead key records
+
+  //vtree nodes, indexed by position (allocated on first insertion)
+  c2dSize vtree_count;
+  DVtree** vtrees;            //vtrees[p] is the vtree node at position p
+  unsigned int* vtree_chains; //1+offset of the first key record of the vtree node at position p (0 if none)
+
+  //aging entries: compressing keys of cold entries, and spilling (when memory exceeds memory_limit)
+  BOOLEAN compress_keys;
+  VtreeSpill* spill;    //NULL if entries are never spilled
+  c2dSize memory_limit;
+  c2dSize clock_hand;   //next hash table slot to be aged
+  c2dSize packed;       //the number of entries with compressed keys
+  c2dSize key_size;     //size of the largest key
+  BYTE* scratch;        //space for (de)compressing the largest key
 } VtreeCache;
 
 /******************************************************************************
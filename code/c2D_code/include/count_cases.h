@@ -0,0 +1,191 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+/******************************************************************************
+ * counting over a semiring: this file is included by count.c once per semiring,
+ * after defining
+ *
+ * --SR(name): the name of function name for the semiring
+ * --SR_ZERO, SR_ONE: the identities of SR_ADD and SR_MUL
+ * --SR_ADD(a,b), SR_MUL(a,b): the operations of the semiring
+ * --SR_WEIGHT(lit): the value of literal lit
+ *
+ * the cache and clause learning are the same for all semirings. truth tables,
+ * bounded counting, anytime bounds and projection are only used with the
+ * sum-product semiring (otherwise, tt_max_vars is 0 and bound is INFINITY)
+ ******************************************************************************/
+
+/******************************************************************************
+ * Case I: leaf vtree (count depends on state of associated variable)
+ ******************************************************************************/
+
+c2dWmc SR(var2count)(Var* var) {
+  if(AUXILIARY_VAR(var)) return SR_ONE;
+  Lit* plit = sat_pos_literal(var);
+  Lit* nlit = sat_neg_literal(var);
+  if(sat_implied_literal(plit))       return SR_WEIGHT(plit);
+  else if(sat_implied_literal(nlit))  return SR_WEIGHT(nlit);
+  else return SR_ADD(SR_WEIGHT(plit),SR_WEIGHT(nlit));
+}
+
+static void SR(count_vtree_leaf)(c2dWmc* count, Clause** learned_clause, const FVtree* node) {
+  assert(FV_IS_LEAF(node));
+  *count = SR(var2count)(node->var);
+  *learned_clause = NULL;
+}
+
+/******************************************************************************
+ * Case II: decomposition node (left and right vtrees are independent)
+ ******************************************************************************/
+
+static void SR(count_vtree_decomposed)(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* vtree_manager, SatState* sat_state) {
+
+  c2dWmc l_count;
+  SET_FRAME(0,0,0,FREE_BOUND(FV_RIGHT(node)));
+  SR(count_dispatcher)(&l_count,learned_clause,FV_LEFT(node),INFINITY,vtree_manager,sat_state);
+  if(threshold_reached) return;
+  if(*learned_clause!=NULL) {
+    drop_vtree_cache_entries(node->vtree->left,vtree_manager);
+    return;
+  }
+  else if(l_count==SR_ZERO) { //optimization
+    *count = SR_ZERO;
+    return;
+  }
+
+  c2dWmc r_count;
+  SET_FRAME(0,l_count,0,l_count);
+  SR(count_dispatcher)(&r_count,learned_clause,FV_RIGHT(node),scale_bound(bound,l_count),vtree_manager,sat_state);
+  if(threshold_reached) return;
+  if(*learned_clause!=NULL) {
+    drop_vtree_cache_entries(node->vtree,vtree_manager);
+    return;
+  }
+
+  assert(*learned_clause==NULL);
+  *count = SR_MUL(l_count,r_count);
+}
+
+/******************************************************************************
+ * Case III: Shannon node (count based on case analysis)
+ ******************************************************************************/
+
+static void SR(count_vtree_shannon)(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* vtree_manager, SatState* sat_state);
+
+//bound is that of node, and literal_bound that of its right child (given literal)
+static inline
+BOOLEAN SR(count_with_literal)(c2dWmc* count, Clause** learned_clause, Lit* literal, const FVtree* node, c2dWmc bound, c2dWmc literal_bound, VtreeManager* vtree_manager, SatState* sat_state) {
+  *learned_clause     = sat_decide_literal(literal,sat_state);
+  if(*learned_clause==NULL) SR(count_dispatcher)(count,learned_clause,FV_RIGHT(node),literal_bound,vtree_manager,sat_state);
+  sat_undo_decide_literal(sat_state);
+  if(threshold_reached) return 0;
+  if(*learned_clause!=NULL) { //a clause was learned
+    if(sat_at_assertion_level(*learned_clause,sat_state)) {
+      *learned_clause = sat_assert_clause(*learned_clause,sat_state);
+      //if another clause was learned, its assertion level must be lower (hence, we must backrack)
+      //if another clause was not learned, then we are ready to try vtree again (with the learned clause)
+      if(*learned_clause==NULL) SR(count_vtree_shannon)(count,learned_clause,node,bound,vtree_manager,sat_state);
+    }
+    return 0; //counting with literal failed as it led to learning at least one clause
+  }
+  else return 1; //counting with literal succeeded without learning clauses
+}
+
+static void SR(count_vtree_shannon)(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* vtree_manager, SatState* sat_state) {
+  Var* var = node->var;
+
+  if(sat_instantiated_var(var) || sat_irrelevant_var(var)) {
+    c2dWmc weight = SR(var2count)(var);
+    SET_FRAME(0,weight,0,weight);
+    SR(count_dispatcher)(count,learned_clause,FV_RIGHT(node),scale_bound(bound,weight),vtree_manager,sat_state);
+    if(*learned_clause==NULL) *count = SR_MUL(*count,weight);
+    return;
+  }
+
+  Lit* plit = sat_pos_literal(var);
+  Lit* nlit = sat_neg_literal(var);
+
+  if(AUXILIARY_VAR(var)) { //below the frontier of projected counting
+    assert(!FV_IS_PROJECTED(node));
+    SET_FRAME(0,1,FREE_BOUND(FV_RIGHT(node)),1);
+    if(!SR(count_with_literal)(count,learned_clause,plit,node,bound,bound,vtree_manager,sat_state)) return;
+    if(*count!=SR_ZERO) return;
+    SET_FRAME(0,1,0,1);
+    SR(count_with_literal)(count,learned_clause,nlit,node,bound,bound,vtree_manager,sat_state);
+    return;
+  }
+
+  c2dWmc pweight = SR_WEIGHT(plit);
+  c2dWmc nweight = SR_WEIGHT(nlit);
+
+  SET_FRAME(0,pweight,nweight*FREE_BOUND(FV_RIGHT(node)),pweight);
+  if(!SR(count_with_literal)(count,learned_clause,plit,node,bound,scale_bound(bound,pweight),vtree_manager,sat_state)) return;
+  assert(*learned_clause==NULL);
+  assert(!sat_instantiated_var(var));
+  c2dWmc pcount = SR_MUL(*count,pweight); //save (weighted) count conditioned on plit
+
+  if(pcount>=bound) { //the count of node is at least pcount
+    threshold_reached = 1;
+    return;
+  }
+
+  SET_FRAME(pcount,nweight,pcount,nweight);
+  if(!SR(count_with_literal)(count,learned_clause,nlit,node,bound,scale_bound(bound-pcount,nweight),vtree_manager,sat_state)) return;
+  assert(*learned_clause==NULL);
+  assert(!sat_instantiated_var(var));
+  c2dWmc ncount = *count; //save count conditioned on nlit
+
+  *count = SR_ADD(pcount,SR_MUL(ncount,nweight));
+}
+
+/******************************************************************************
+ * Count dispatcher
+ ******************************************************************************/
+
+//bound is the bound of node for bounded counting (INFINITY if counting is not bounded)
+void SR(count_dispatcher)(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* vtree_manager, SatState* sat_state) {
+
+  if(anytime_report) report_bounds(node);
+
+  //leaves need neither the cache nor truth tables
+  if(FV_IS_LEAF(node)) {
+    SR(count_vtree_leaf)(count,learned_clause,node);
+  }
+  //small vtrees are counted directly, bypassing the solver and the cache
+  else if(node->var_count<=2*tt_max_vars && tt_count_vtree(count,node)) {
+    *learned_clause = NULL;
+  }
+  else {
+    //check cache
+    VtreeCV item;
+    BOOLEAN cache = FV_SHOULD_CACHE(node);
+    if(cache && lookup_cache(&item,node->vtree,vtree_manager)) {
+      *count = item.count;
+      *learned_clause = NULL;
+    }
+    else {
+      //need to count (the case sets the frame of node)
+      CountFrame frame;
+      frame.parent = top_frame;
+      top_frame    = &frame;
+      if(FV_IS_SHANNON(node))
+        SR(count_vtree_shannon)(count,learned_clause,node,bound,vtree_manager,sat_state);
+      else
+        SR(count_vtree_decomposed)(count,learned_clause,node,bound,vtree_manager,sat_state);
+      top_frame = frame.parent;
+      if(threshold_reached) return; //count is not meaningful (and is not cached)
+
+      //cache if a count is returned (and learned clauses have not instantiated the Shannon variable)
+      if(*learned_clause==NULL && cache && FV_SHOULD_CACHE(node)) { //otherwise, a count has not been returned
+        item.count = *count;
+        insert_cache(item,node->vtree,vtree_manager);
+      }
+    }
+  }
+
+  if(*learned_clause==NULL && *count>=bound) threshold_reached = 1;
+}
+
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _XOPEN_SOURCE 600 //sigaction, alarm, SA_RESTART
+#include <unistd.h>
+#include <signal.h>
+#include "c2d.h"
+
+/******************************************************************************
+ * anytime bounds: requests for the bounds on the count of an unfinished model
+ * counter
+ *
+ * --an alarm requests the bounds every interval seconds
+ * --SIGTERM requests the bounds, after which counting is terminated
+ *
+ * the handlers only set flags: the counter checks them when it enters a vtree
+ * node, where the bounds can be computed (see count.c)
+ ******************************************************************************/
+
+volatile sig_atomic_t anytime_report;    //bounds are requested
+volatile sig_atomic_t anytime_terminate; //counting must be terminated after reporting bounds
+
+static unsigned int interval; //seconds between bound reports (0 for none)
+static struct sigaction old_term_action;
+
+static void on_alarm(int signal) {
+  anytime_report = 1;
+  alarm(interval);
+}
+
+static void on_term(int signal) {
+  anytime_report    = 1;
+  anytime_terminate = 1;
+}
+
+void anytime_start(unsigned int seconds) {
+  struct sigaction action;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+
+  interval          = seconds;
+  anytime_report    = 0;
+  anytime_terminate = 0;
+
+  action.sa_handler = on_term;
+  sigaction(SIGTERM,&action,&old_term_action);
+  if(interval>0) {
+    action.sa_handler = on_alarm;
+    sigaction(SIGALRM,&action,NULL);
+    alarm(interval);
+  }
+}
+
+void anytime_stop() {
+  if(interval>0) alarm(0);
+  sigaction(SIGTERM,&old_term_action,NULL);
+  anytime_report = 0;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,245 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include <math.h>
+#include "c2d.h"
+
+/******************************************************************************
+ * approximate model counting by hashing:
+ *
+ * --m random XOR constraints (hashes) split the models of the cnf into 2^m cells
+ *   of about the same size, so the count is about 2^m times the models of a cell
+ * --the models of a cell are counted by enumeration, which stops once a bound
+ *   (threshold) is reached, and m is the smallest number of hashes for which the
+ *   cell is under the threshold
+ * --this is repeated with fresh hashes, and the median of the estimates is the
+ *   count: it is within a factor of 1+epsilon of the model count with probability
+ *   at least 1-delta (ApproxMC)
+ *
+ * the hashes are pushed onto the sat state (before unit resolution), and propagated
+ * along with the clauses by Gauss-Jordan elimination, so the same sat state is
+ * used for all cells
+ *
+ * the hashes of a repetition are used as prefixes, so the cells shrink as m grows:
+ * m is found by galloping from the m of the previous repetition, followed by a
+ * binary search (most repetitions then count only a few cells)
+ *
+ * enumeration decides the relevant variables one by one (a variable is relevant
+ * while it appears in some clause that is not subsumed). once no relevant variable
+ * is left, the models of the cell are the assignments of the remaining variables
+ * that satisfy the hashes. a contradiction ends its branch: learned clauses are
+ * not asserted, since they may depend on the hashes of the cell
+ *
+ * weights are ignored: the count is the number of models of the cnf, and all
+ * variables are hashed (the sampling set is the set of all variables)
+ ******************************************************************************/
+
+//seed of the random hashes (runs are reproducible)
+#define APPROX_SEED 0x9E3779B97F4A7C15UL
+
+static c2dSize var_count;
+static double threshold; //cells with this many models are too big
+static c2dSize cells;    //the number of cells counted
+static c2dSize hashes;   //the median number of hashes of the repetitions
+static c2dSize repetitions;
+
+static unsigned long random_state;
+
+//xorshift64*
+static unsigned long random_word() {
+  random_state ^= random_state>>12;
+  random_state ^= random_state<<25;
+  random_state ^= random_state>>27;
+  return random_state*2685821657736338717UL;
+}
+
+/******************************************************************************
+ * hashes: each variable appears in a hash with probability 1/2
+ ******************************************************************************/
+
+static c2dSize** hash_vars;    //variable indices of each hash of the current repetition
+static c2dSize* hash_sizes;
+static BOOLEAN* hash_parities;
+static c2dSize hash_count;     //the number of hashes generated for the current repetition
+
+static void generate_hash() {
+  c2dSize* vars = (c2dSize*) malloc(var_count*sizeof(c2dSize));
+  c2dSize size  = 0;
+  unsigned long bits = 0;
+  for(c2dSize i=0; i<var_count; i++) {
+    if(i%64==0) bits = random_word();
+    if(bits&1) vars[size++] = i+1;
+    bits >>= 1;
+  }
+  hash_vars[hash_count]     = vars;
+  hash_sizes[hash_count]    = size;
+  hash_parities[hash_count] = random_word()&1;
+  ++hash_count;
+}
+
+static void free_hashes() {
+  for(c2dSize i=0; i<hash_count; i++) free(hash_vars[i]);
+  hash_count = 0;
+}
+
+/******************************************************************************
+ * counting the models of a cell
+ ******************************************************************************/
+
+//returns a variable that is not instantiated and appears in some clause that is not subsumed,
+//NULL if there is none
+static Var* relevant_var(const SatState* sat_state) {
+  for(c2dSize i=1; i<=var_count; i++) {
+    Var* var = sat_index2var(i,sat_state);
+    if(!sat_instantiated_var(var) && !sat_irrelevant_var(var)) return var;
+  }
+  return NULL;
+}
+
+//returns the models of the cnf and hashes under the current setting, or some number of
+//models no less than bound
+//
+//the current setting is a fixpoint of unit resolution (and XOR propagation), so the hashes
+//have a distinct unassigned pivot for each of their rows with an unassigned variable
+static double bounded_count(double bound, SatState* sat_state) {
+  Var* var = relevant_var(sat_state);
+  if(var==NULL) {
+    c2dSize free_vars = 0;
+    for(c2dSize i=1; i<=var_count; i++) if(!sat_instantiated_var(sat_index2var(i,sat_state))) ++free_vars;
+    return ldexp(1.0,(int)(free_vars-sat_xor_rank(sat_state)));
+  }
+
+  double count = 0;
+  Lit* lits[2] = { sat_pos_literal(var), sat_neg_literal(var) };
+  for(int i=0; i<2 && count<bound; i++) {
+    Clause* learned_clause = sat_decide_literal(lits[i],sat_state);
+    if(learned_clause==NULL) count += bounded_count(bound-count,sat_state);
+    else sat_discard_clause(learned_clause);
+    sat_undo_decide_literal(sat_state);
+  }
+  return count;
+}
+
+//returns the models of the cell of the first m hashes (or some number no less than threshold)
+static double count_cell(c2dSize m, SatState* sat_state) {
+  while(hash_count<m) generate_hash();
+  for(c2dSize i=0; i<m; i++) sat_push_xor(hash_vars[i],hash_sizes[i],hash_parities[i],sat_state);
+  double count = sat_unit_resolution(sat_state)? bounded_count(threshold,sat_state): 0;
+  sat_undo_unit_resolution(sat_state);
+  for(c2dSize i=0; i<m; i++) sat_pop_xor(sat_state);
+  ++cells;
+  return count;
+}
+
+/******************************************************************************
+ * searching for the number of hashes
+ ******************************************************************************/
+
+//returns the estimate of one repetition, using fresh hashes
+//*m is the number of hashes of the previous repetition, and is set to that of this one
+static double estimate(c2dSize* m, double* cell_counts, SatState* sat_state) {
+  #define COUNT(k) (cell_counts[k]<0? (cell_counts[k] = count_cell(k,sat_state)): cell_counts[k])
+  for(c2dSize k=1; k<=var_count; k++) cell_counts[k] = -1;
+  c2dSize lo = 0;            //the cell of lo hashes is too big (cell_counts[0] is known)
+  c2dSize hi = var_count;    //the cell of hi hashes is small (or hi is the number of variables)
+  c2dSize guess = *m<1? 1: *m>var_count? var_count: *m;
+
+  //gallop from the previous number of hashes
+  if(COUNT(guess)<threshold) {
+    hi = guess;
+    for(c2dSize step=1; hi-lo>1; step *= 2) {
+      c2dSize k = hi>lo+step? hi-step: lo+1;
+      if(COUNT(k)<threshold) hi = k;
+      else { lo = k; break; }
+    }
+  }
+  else {
+    lo = guess;
+    for(c2dSize step=1; hi-lo>1; step *= 2) {
+      c2dSize k = lo+step<hi? lo+step: hi-1;
+      if(COUNT(k)<threshold) { hi = k; break; }
+      else lo = k;
+    }
+  }
+  //binary search
+  while(hi-lo>1) {
+    c2dSize k = lo+(hi-lo)/2;
+    if(COUNT(k)<threshold) hi = k;
+    else lo = k;
+  }
+  *m = hi;
+  double count = ldexp(COUNT(hi),(int)hi);
+  #undef COUNT
+  free_hashes();
+  return count;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x>y)-(x<y);
+}
+
+static int compare_sizes(const void* a, const void* b) {
+  c2dSize x = *(const c2dSize*)a;
+  c2dSize y = *(const c2dSize*)b;
+  return (x>y)-(x<y);
+}
+
+/******************************************************************************
+ * main approximate counting code
+ ******************************************************************************/
+
+c2dWmc approx_count(SatState* sat_state, const c2dOptions* options) {
+  double epsilon = options->epsilon;
+  var_count      = sat_var_count(sat_state);
+  threshold      = 1+9.84*(1+epsilon/(1+epsilon))*(1+1/epsilon)*(1+1/epsilon);
+  repetitions    = (c2dSize) ceil(17*log2(3/options->delta));
+  cells          = 0;
+  hashes         = 0;
+  random_state   = APPROX_SEED;
+
+  double* cell_counts = (double*) malloc((var_count+1)*sizeof(double));
+  double count = cell_counts[0] = count_cell(0,sat_state);
+  if(count>=threshold) { //too many models to be counted exactly
+    hash_vars     = (c2dSize**) malloc(var_count*sizeof(c2dSize*));
+    hash_sizes    = (c2dSize*) malloc(var_count*sizeof(c2dSize));
+    hash_parities = (BOOLEAN*) malloc(var_count*sizeof(BOOLEAN));
+    hash_count    = 0;
+    double* estimates = (double*) malloc(repetitions*sizeof(double));
+    c2dSize* ms       = (c2dSize*) malloc(repetitions*sizeof(c2dSize));
+    c2dSize m = 1;
+    for(c2dSize i=0; i<repetitions; i++) {
+      estimates[i] = estimate(&m,cell_counts,sat_state);
+      ms[i]        = m;
+    }
+    qsort(estimates,repetitions,sizeof(double),compare_doubles);
+    qsort(ms,repetitions,sizeof(c2dSize),compare_sizes);
+    count  = estimates[repetitions/2];
+    hashes = ms[repetitions/2];
+    free(estimates);
+    free(ms);
+    free(hash_vars);
+    free(hash_sizes);
+    free(hash_parities);
+  }
+  free(cell_counts);
+  return count;
+}
+
+/******************************************************************************
+ * stats
+ ******************************************************************************/
+
+void print_approx_stats(const c2dOptions* options) {
+  printf("\n  Approx bounds\tepsilon %.3f, delta %.3f",options->epsilon,options->delta);
+  printf("\n  Approx cells\t%"PRIvS" (threshold %.0f, %"PRIvS" repetitions)",cells,ceil(threshold),repetitions);
+  printf("\n  Approx hashes\t%"PRIvS"",hashes);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -8,28 +8,87 @@
 
 //key.c
 void construct_vtree_key(DVtree *vtree);
+HASHCODE key_hashcode(c2dSize position, const BYTE* key, c2dSize size);
 //utilities.c
 void pprint_bytes(const char* string, c2dSize bytes);
+//spill.c
+VtreeSpill* construct_vtree_spill(const char* filename, c2dSize vtree_count, c2dSize key_size);
+void free_vtree_spill(VtreeSpill* spill);
+void fork_vtree_spill(VtreeSpill* spill);
+void spill_entry(const DVtree* vtree, const BYTE* key, VtreeCV value, VtreeSpill* spill);
+BOOLEAN lookup_spill(VtreeCV* result, const DVtree* vtree, VtreeSpill* spill);
+void drop_spilled_entries(const DVtree* vtree, VtreeSpill* spill);
+void print_vtree_spill_stats(const VtreeSpill* spill);
 
 //local declarations
 BOOLEAN match_keys(register BYTE* key1, register BYTE* key2, register c2dSize size);
 void copy_key(register BYTE* key1, register BYTE* key2, register c2dSize size);
+void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager);
 
 /******************************************************************************
- * the cache is implemented as an array of linked lists:
+ * the cache is implemented as a hash table with open addressing:
  *
- * --the elements of each linked list are cache entries
+ * --the slots of the hash table are cache entries
  * --a cache entry contains a key (identifies a cnf) and a computed value (count or nnf node)
  * --each key has a hash code (a number)
- * --cache entries in the same linked list have the same hashcode
- * --the hashcode indexes a cache entry into the cache (array of linked lists)
+ * --the hashcode indexes a cache entry into the cache: the entry is stored at the
+ *   first free slot starting from that index (linear probing)
+ *
+ * entries are 16 bytes: they refer to their vtree node by its position, and to
+ * their key by an offset into a key arena (keys are not allocated one by one)
+ *
+ * the hash table and the key arena are mapped as huge page regions where
+ * available (see huge.c of the sat library), as cache lookups rarely hit the
+ * same base page twice. they are interleaved over the NUMA nodes of workers
+ * (see cubes.c)
  *
  * each vtree node has a list of cache entries associated with it (i.e., cache entries
  * for cnfs that are associated with that vtree node). this additional indexing
- * facilitates dropping cache entries that are associated with a given vtree node
+ * facilitates dropping cache entries that are associated with a given vtree node.
+ * the list is chained through the key records of the entries
+ *
+ * dropped entries leave deleted slots in the hash table and dead key records in
+ * the key arena. the hash table is rebuilt when its free slots run low, and the
+ * key arena is compacted when it would otherwise grow while mostly dead
+ *
+ * cache entries can be aged using the CLOCK policy: an entry is referenced when
+ * inserted or hit, and a clock hand sweeps the hash table. the hand clears the
+ * reference of a referenced entry; an unreferenced entry is cold:
+ *
+ * --if key compression is on, the key of a cold entry is compressed (if this
+ *   saves space). the hand advances a couple of slots per insertion
+ * --if a memory limit is set, and the memory of entries exceeds the limit, the
+ *   hand sweeps until a cold entry is spilled to a file (see spill.c). a miss in
+ *   the cache is then looked up among the spilled entries, and an entry found
+ *   there is inserted back into the cache
+ *
+ * keys are compressed using run-length encoding (PackBits), as keys mostly
+ * consist of runs of 0 bits (subsumed clauses, free variables). a compressed
+ * key is preceded by the low bits of its hash code (as a fingerprint), so it is
+ * only compared with a key when their fingerprints match
  *
  ******************************************************************************/
- 
+
+//hash table is rebuilt when more than 3/4 of its slots are not free
+#define CACHE_MAX_LOAD(capacity) ((3*(capacity))/4)
+
+//initial size of key arena (in cells)
+#define KEY_ARENA_CELLS (1UL<<16)
+
+//number of cells in the key record of the vtree node
+#define KEY_RECORD_CELLS(vtree) (1+((vtree)->key_size+sizeof(VtreeKH)-1)/sizeof(VtreeKH))
+
+#define KEY_HEADER(cache,offset) ((cache)->keys+(offset))
+#define KEY_CELLS(cache,offset)  ((BYTE*)((cache)->keys+(offset)+1))
+
+//a compressed key is preceded by a fingerprint (low bits of the hash code of key)
+#define PACKED_FINGERPRINT(cache,offset) (*(unsigned int*)KEY_CELLS(cache,offset))
+#define PACKED_KEY_CELLS(cache,offset)   (KEY_CELLS(cache,offset)+sizeof(unsigned int))
+#define PACKED_RECORD_CELLS(size)        (1+(sizeof(unsigned int)+(size)+sizeof(VtreeKH)-1)/sizeof(VtreeKH))
+
+//entries visited by the clock hand per insertion, when compressing keys
+#define AGING_RATE 2
+
 /******************************************************************************
  * constructing and freeing a cache
  *
@@ -37,45 +96,229 @@ void copy_key(register BYTE* key1, register BYTE* key2, register c2dSize size);
  ******************************************************************************/
 
 VtreeCache* construct_vtree_cache(c2dSize capacity) {
+  assert(capacity<VTREE_KH_PACKED);
   VtreeCache* cache = (VtreeCache*) malloc(sizeof(VtreeCache));
-  
-  cache->buckets    = (VtreeCE**) calloc(capacity,sizeof(VtreeCE*));
-  cache->capacity   = capacity;
-  cache->count      = 0;
-  cache->memory     = 0;
-  cache->hits       = 0;
-  cache->misses     = 0;
+
+  cache->table        = (VtreeCE*) sat_huge_alloc(capacity*sizeof(VtreeCE));
+  cache->capacity     = capacity;
+  cache->count        = 0;
+  cache->deleted      = 0;
+  cache->memory       = 0;
+  cache->hits         = 0;
+  cache->misses       = 0;
+  cache->probes       = 0;
+  cache->keys         = (VtreeKH*) sat_huge_alloc(KEY_ARENA_CELLS*sizeof(VtreeKH));
+  cache->key_capacity = KEY_ARENA_CELLS;
+  cache->key_used     = 0;
+  cache->key_garbage  = 0;
+  cache->vtree_count  = 0;
+  cache->vtrees       = NULL;
+  cache->vtree_chains = NULL;
+  cache->compress_keys = 0;
+  cache->spill        = NULL;
+  cache->memory_limit = 0;
+  cache->clock_hand   = 0;
+  cache->packed       = 0;
+  cache->scratch      = NULL;
   return cache;
 }
 
-void free_cache_entry(VtreeCE* entry) {
-  free(entry->key);
-  free(entry);
+void free_vtree_cache(VtreeCache* cache) {
+  if(cache->spill!=NULL) free_vtree_spill(cache->spill);
+  sat_huge_free(cache->table,cache->capacity*sizeof(VtreeCE)); //free hash table (and entries)
+  sat_huge_free(cache->keys,cache->key_capacity*sizeof(VtreeKH));
+  free(cache->vtrees);
+  free(cache->vtree_chains);
+  free(cache->scratch);
+  free(cache);
 }
 
-void free_vtree_cache(VtreeCache* cache) {
-  //free cache entries
-  for(c2dSize i=0; i<cache->capacity; i++) {
-    VtreeCE* entry = cache->buckets[i];
-    while(entry!=NULL) {
-      VtreeCE* next = entry->next;
-      free_cache_entry(entry);
-      entry = next;
-    }
+//prepare the per vtree node lists of cache entries
+//return the size of the largest key
+static c2dSize index_vtree_nodes(DVtree* vtree, VtreeCache* cache) {
+  cache->vtrees[vtree->position] = vtree;
+  c2dSize size = vtree->key_size;
+  if(vtree->left!=NULL) {
+    c2dSize l_size = index_vtree_nodes(vtree->left,cache);
+    c2dSize r_size = index_vtree_nodes(vtree->right,cache);
+    if(l_size>size) size = l_size;
+    if(r_size>size) size = r_size;
   }
-  
-  free(cache->buckets); //free hash table
-  free(cache);
+  return size;
+}
+
+
+static void construct_vtree_chains(VtreeManager* manager) {
+  VtreeCache* cache   = manager->cache;
+  cache->vtree_count  = 2*manager->vtree->var_count-1;
+  cache->vtrees       = (DVtree**) malloc(cache->vtree_count*sizeof(DVtree*));
+  cache->vtree_chains = (unsigned int*) calloc(cache->vtree_count,sizeof(unsigned int));
+  cache->key_size     = index_vtree_nodes(manager->vtree,cache);
+  cache->scratch      = (BYTE*) malloc(cache->key_size+1);
+}
+
+//spill cache entries to file once their memory exceeds the limit (in MB)
+//this is called after constructing the vtree manager (and before the cache is used)
+void set_vtree_cache_spill(const char* filename, c2dSize memory, VtreeManager* manager) {
+  VtreeCache* cache = manager->cache;
+  assert(cache->count==0);
+  if(cache->vtrees==NULL) construct_vtree_chains(manager);
+  assert(cache->vtree_count<VTREE_CE_REFERENCED);
+  cache->spill        = construct_vtree_spill(filename,cache->vtree_count,cache->key_size);
+  cache->memory_limit = memory*1024*1024;
+}
+
+//interleave the hash table and key arena over the NUMA nodes
+//this is called before forking workers on several nodes, which all read the cache as filled
+void interleave_vtree_cache(VtreeManager* manager) {
+  VtreeCache* cache = manager->cache;
+  sat_huge_interleave(cache->table,cache->capacity*sizeof(VtreeCE));
+  sat_huge_interleave(cache->keys,cache->key_capacity*sizeof(VtreeKH));
+}
+
+//called by a forked worker: it spills to a file of its own, and the pages of the cache it
+//copies on write land on its node
+void fork_vtree_cache(VtreeManager* manager) {
+  VtreeCache* cache = manager->cache;
+  if(cache->spill!=NULL) fork_vtree_spill(cache->spill);
+  sat_huge_local(cache->table,cache->capacity*sizeof(VtreeCE));
+  sat_huge_local(cache->keys,cache->key_capacity*sizeof(VtreeKH));
+}
+
+//compress the keys of cache entries that were not hit recently
+//this is called after constructing the vtree manager (and before the cache is used)
+void set_vtree_cache_compression(VtreeManager* manager) {
+  VtreeCache* cache = manager->cache;
+  assert(cache->count==0);
+  if(cache->vtrees==NULL) construct_vtree_chains(manager);
+  cache->compress_keys = 1;
 }
 
 /******************************************************************************
- * which vtree nodes to cache at: CRITICAL to performance
+ * compressed keys
  ******************************************************************************/
- 
-static BOOLEAN should_cache(const DVtree* vtree) {
-  return vtree->live_cache && 
-         vtree_is_shannon_node(vtree) && 
-         !sat_instantiated_var(vtree_shannon_var(vtree));
+
+//compress key (of size bytes) into packed, using PackBits:
+//a control byte c<128 is followed by c+1 literal bytes, and a control byte c>128
+//is followed by a byte repeated 257-c times
+//return the size of packed, or 0 if it would not be smaller than limit
+static c2dSize pack_key(const BYTE* key, c2dSize size, BYTE* packed, c2dSize limit) {
+  c2dSize n = 0;
+  c2dSize i = 0;
+  while(i<size) {
+    c2dSize run = 1;
+    while(i+run<size && run<128 && key[i+run]==key[i]) ++run;
+    if(run>=2) {
+      if(n+2>=limit) return 0;
+      packed[n++] = (BYTE)(257-run);
+      packed[n++] = key[i];
+      i += run;
+    }
+    else { //literals, up to the next run
+      c2dSize count = 1;
+      while(i+count<size && count<128 && !(i+count+1<size && key[i+count]==key[i+count+1])) ++count;
+      if(n+1+count>=limit) return 0;
+      packed[n++] = (BYTE)(count-1);
+      memcpy(packed+n,key+i,count);
+      n += count;
+      i += count;
+    }
+  }
+  return n;
+}
+
+static void unpack_key(const BYTE* packed, c2dSize size, BYTE* key) {
+  const BYTE* end = key+size;
+  while(key<end) {
+    BYTE c = *packed++;
+    if(c<128) {
+      memcpy(key,packed,c+1);
+      key    += c+1;
+      packed += c+1;
+    }
+    else {
+      memset(key,*packed++,257-c);
+      key += 257-c;
+    }
+  }
+}
+
+//return the size of packed (the compression of a key of size bytes)
+static c2dSize packed_size(const BYTE* packed, c2dSize size) {
+  const BYTE* start = packed;
+  while(size>0) {
+    BYTE c = *packed++;
+    if(c<128) {
+      packed += c+1;
+      size   -= c+1;
+    }
+    else {
+      ++packed;
+      size -= 257-c;
+    }
+  }
+  return packed-start;
+}
+
+//return 1 if packed is the compression of key, 0 otherwise (without decompressing)
+//(key and the decompression of packed have the same size)
+static BOOLEAN match_packed_key(const BYTE* key, c2dSize size, const BYTE* packed) {
+  const BYTE* key_end = key+size;
+  while(key<key_end) {
+    BYTE c = *packed++;
+    c2dSize count = c<128? c+1: 257-c;
+    if(c<128) {
+      if(memcmp(key,packed,count)!=0) return 0;
+      packed += count;
+    }
+    else {
+      BYTE byte = *packed++;
+      for(c2dSize i=0; i<count; i++) if(key[i]!=byte) return 0;
+    }
+    key += count;
+  }
+  return 1;
+}
+
+//return the number of cells of a key record
+static c2dSize record_cells(c2dSize offset, const DVtree* vtree, VtreeCache* cache) {
+  if(KEY_HEADER(cache,offset)->slot&VTREE_KH_PACKED)
+    return PACKED_RECORD_CELLS(packed_size(PACKED_KEY_CELLS(cache,offset),vtree->key_size));
+  else return KEY_RECORD_CELLS(vtree);
+}
+
+//return the (decompressed) key of a key record
+static const BYTE* record_key(c2dSize offset, const DVtree* vtree, VtreeCache* cache) {
+  if(KEY_HEADER(cache,offset)->slot&VTREE_KH_PACKED) {
+    unpack_key(PACKED_KEY_CELLS(cache,offset),vtree->key_size,cache->scratch);
+    return cache->scratch;
+  }
+  else return KEY_CELLS(cache,offset);
+}
+
+//compress the key of a key record in place (if this saves space)
+//the cells no longer used by the key record become a dead record
+static void compress_key_record(c2dSize offset, const DVtree* vtree, VtreeCache* cache) {
+  c2dSize cells = KEY_RECORD_CELLS(vtree);
+  //packed key must save at least one cell
+  if(cells<3) return;
+  c2dSize limit = (cells-2)*sizeof(VtreeKH)-sizeof(unsigned int)+1;
+  c2dSize size  = pack_key(KEY_CELLS(cache,offset),vtree->key_size,cache->scratch,limit);
+  if(size==0) return;
+
+  HASHCODE hashcode = key_hashcode(vtree->position,KEY_CELLS(cache,offset),vtree->key_size);
+  PACKED_FINGERPRINT(cache,offset) = (unsigned int)hashcode;
+  memcpy(PACKED_KEY_CELLS(cache,offset),cache->scratch,size);
+  KEY_HEADER(cache,offset)->slot |= VTREE_KH_PACKED;
+
+  c2dSize packed_cells = PACKED_RECORD_CELLS(size);
+  assert(packed_cells<cells);
+  VtreeKH* tail      = KEY_HEADER(cache,offset+packed_cells);
+  tail->slot         = VTREE_KH_DEAD;
+  tail->vtree_next   = cells-packed_cells;
+  cache->key_garbage += cells-packed_cells;
+  cache->memory      -= (cells-packed_cells)*sizeof(VtreeKH);
+  ++cache->packed;
 }
 
 /******************************************************************************
@@ -84,164 +327,336 @@ static BOOLEAN should_cache(const DVtree* vtree) {
 
 //return 1 if lookup is successful, 0 otherwise
 //if lookup is successful, set the value of result accordingly
+//assume that the vtree node should be cached at (see FV_SHOULD_CACHE in c2d.h)
 BOOLEAN lookup_cache(VtreeCV* result, DVtree* vtree, VtreeManager* manager) {
-  if(!should_cache(vtree)) return 0;
   assert(vtree->cached_size!=0);
-  
+
   //capture the state of cnf associated with vtree as a bit vector and corresponding hash code
-  construct_vtree_key(vtree); 
+  construct_vtree_key(vtree);
   //the following fields are now current
   BYTE* key         = vtree->key; //bit vector
   c2dSize size      = vtree->key_size;
   HASHCODE hashcode = vtree->key_hashcode;
-    
-  VtreeCache* cache = manager->cache;
-  c2dSize index     = hashcode % cache->capacity;
-  VtreeCE* entry    = cache->buckets[index]; //first entry in collision list
-  
-  while(entry!=NULL) {
-    if(vtree==entry->vtree && match_keys(key,entry->key,size)) {
+
+  VtreeCache* cache  = manager->cache;
+  c2dSize slot       = hashcode % cache->capacity;
+  unsigned int id    = vtree->position+1;
+  VtreeCE* entry     = cache->table+slot; //first entry in probe sequence
+
+  while(entry->vtree!=VTREE_CE_EMPTY) {
+    ++cache->probes;
+    if(id==(entry->vtree&~VTREE_CE_REFERENCED) && 
+       ((KEY_HEADER(cache,entry->key)->slot&VTREE_KH_PACKED)==0? 
+         match_keys(key,KEY_CELLS(cache,entry->key),size):
+         PACKED_FINGERPRINT(cache,entry->key)==(unsigned int)hashcode &&
+         match_packed_key(key,size,PACKED_KEY_CELLS(cache,entry->key)))) {
       //hit
       ++cache->hits;
+      entry->vtree |= VTREE_CE_REFERENCED;
       *result = entry->value;
       return 1;
     }
-    else entry = entry->next;
+    if(++slot==cache->capacity) slot = 0;
+    entry = cache->table+slot;
+  }
+
+  if(cache->spill!=NULL && lookup_spill(result,vtree,cache->spill)) {
+    //hit (among spilled entries): promote entry
+    ++cache->hits;
+    insert_cache(*result,vtree,manager);
+    return 1;
   }
 
   //miss
   ++cache->misses;
-  
+
+  return 0;
+}
+
+/******************************************************************************
+ * maintaining the hash table and the key arena
+ ******************************************************************************/
+
+//return the first slot that is free (empty or deleted) starting from hashcode
+static c2dSize free_slot(HASHCODE hashcode, const VtreeCE* table, c2dSize capacity) {
+  c2dSize slot = hashcode % capacity;
+  while(table[slot].vtree!=VTREE_CE_EMPTY && table[slot].vtree!=VTREE_CE_DELETED)
+    if(++slot==capacity) slot = 0;
+  return slot;
+}
+
+//move the entries of the hash table into a new table (without deleted slots)
+static void rebuild_hash_table(VtreeCache* cache) {
+  c2dSize capacity = cache->capacity;
+  if(2*(cache->count+1)>capacity) capacity = 2*capacity+1; //mostly live: grow
+  assert(capacity<VTREE_KH_PACKED);
+  VtreeCE* table = (VtreeCE*) sat_huge_alloc(capacity*sizeof(VtreeCE));
+
+  for(c2dSize i=0; i<cache->capacity; i++) {
+    VtreeCE* entry = cache->table+i;
+    if(!VTREE_CE_LIVE(entry)) continue;
+    DVtree* vtree  = cache->vtrees[VTREE_CE_POSITION(entry)];
+    HASHCODE hashcode = key_hashcode(vtree->position,record_key(entry->key,vtree,cache),vtree->key_size);
+    c2dSize slot   = free_slot(hashcode,table,capacity);
+    table[slot]    = *entry;
+    VtreeKH* header = KEY_HEADER(cache,entry->key);
+    header->slot   = (header->slot&VTREE_KH_PACKED)|slot;
+  }
+
+  sat_huge_free(cache->table,cache->capacity*sizeof(VtreeCE));
+  cache->table      = table;
+  cache->capacity   = capacity;
+  cache->deleted    = 0;
+  cache->clock_hand = 0;
+}
+
+//move live key records to the front of the key arena, then rebuild the
+//lists of cache entries of vtree nodes
+static void compact_key_arena(VtreeCache* cache) {
+  for(c2dSize p=0; p<cache->vtree_count; p++) cache->vtree_chains[p] = 0;
+
+  c2dSize used = 0;
+  c2dSize offset = 0;
+  while(offset<cache->key_used) {
+    VtreeKH* header = KEY_HEADER(cache,offset);
+    if(header->slot==VTREE_KH_DEAD) {
+      offset += header->vtree_next; //size of dead record
+      continue;
+    }
+    if(header->slot&VTREE_KH_SPILLED) {
+      offset += record_cells(offset,cache->vtrees[VTREE_KH_SLOT(header)],cache);
+      continue;
+    }
+    VtreeCE* entry = cache->table+VTREE_KH_SLOT(header);
+    c2dSize p      = VTREE_CE_POSITION(entry);
+    c2dSize cells  = record_cells(offset,cache->vtrees[p],cache);
+    if(used!=offset) memmove(KEY_HEADER(cache,used),header,cells*sizeof(VtreeKH));
+    header             = KEY_HEADER(cache,used);
+    header->vtree_next = cache->vtree_chains[p];
+    cache->vtree_chains[p] = used+1;
+    entry->key         = used;
+    used   += cells;
+    offset += cells;
+  }
+
+  cache->key_used    = used;
+  cache->key_garbage = 0;
+}
+
+//return the offset of a new key record with the given number of cells
+static c2dSize new_key_record(c2dSize cells, VtreeCache* cache) {
+  if(cache->key_used+cells>cache->key_capacity) {
+    //compact rather than grow when at least half the arena is dead
+    if(2*cache->key_garbage>=cache->key_used) compact_key_arena(cache);
+    c2dSize capacity = cache->key_capacity;
+    while(cache->key_used+cells>cache->key_capacity) cache->key_capacity *= 2;
+    assert(cache->key_capacity<=VTREE_KH_DEAD);
+    cache->keys = (VtreeKH*) sat_huge_realloc(cache->keys,capacity*sizeof(VtreeKH),cache->key_capacity*sizeof(VtreeKH));
+    if(cache->keys==NULL) {
+      fprintf(stderr,"c2D: cannot allocate cache keys\n");
+      exit(1);
+    }
+  }
+  c2dSize offset   = cache->key_used;
+  cache->key_used += cells;
+  return offset;
+}
+
+/******************************************************************************
+ * aging entries: compressing keys and spilling
+ ******************************************************************************/
+
+//move a cache entry from the cache to the spill file
+static void spill_cache_entry(VtreeCE* entry, VtreeCache* cache) {
+  c2dSize p       = VTREE_CE_POSITION(entry);
+  DVtree* vtree   = cache->vtrees[p];
+  c2dSize cells   = record_cells(entry->key,vtree,cache);
+  VtreeKH* header = KEY_HEADER(cache,entry->key);
+  spill_entry(vtree,record_key(entry->key,vtree,cache),entry->value,cache->spill);
+
+  //remove from hash table (key record stays chained until entries of vtree are dropped)
+  if(header->slot&VTREE_KH_PACKED) --cache->packed;
+  entry->vtree = VTREE_CE_DELETED;
+  ++cache->deleted;
+  header->slot = VTREE_KH_SPILLED|(header->slot&VTREE_KH_PACKED)|p;
+  cache->key_garbage += cells;
+  //update stats
+  --cache->count;
+  cache->memory -= sizeof(VtreeCE) + cells*sizeof(VtreeKH);
+}
+
+//age the next entry at the clock hand, then advance the hand
+//a cold entry has its key compressed (if compression is on and saves space),
+//otherwise it is spilled (if spill is set)
+//return 1 if the memory of entries was reduced, 0 otherwise
+static BOOLEAN age_cache_entry(BOOLEAN spill, VtreeCache* cache) {
+  assert(cache->count!=0);
+  VtreeCE* entry;
+  do {
+    entry = cache->table+cache->clock_hand;
+    if(++cache->clock_hand==cache->capacity) cache->clock_hand = 0;
+  } while(!VTREE_CE_LIVE(entry));
+  if(entry->vtree&VTREE_CE_REFERENCED) {
+    entry->vtree &= ~VTREE_CE_REFERENCED;
+    return 0;
+  }
+  if(cache->compress_keys && (KEY_HEADER(cache,entry->key)->slot&VTREE_KH_PACKED)==0) {
+    c2dSize packed = cache->packed;
+    compress_key_record(entry->key,cache->vtrees[VTREE_CE_POSITION(entry)],cache);
+    if(cache->packed!=packed) return 1;
+  }
+  if(spill) {
+    spill_cache_entry(entry,cache);
+    return 1;
+  }
   return 0;
 }
- 
+
 /******************************************************************************
  * insert
  ******************************************************************************/
 
 //insert a computed value (count or nnf node) into the cache
-//the computed value is associated with the current cnf associated with the vtree node 
+//the computed value is associated with the current cnf associated with the vtree node
 //assume that lookup_cache has been already called to set the cnf key and hashcode
-void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager) {  
-  if(!should_cache(vtree)) return;
-  assert(vtree->cached_size!=0); 
-    
+void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager) {
+  assert(vtree->cached_size!=0);
+
   //key and hashcode are assumed current
   VtreeCache* cache   = manager->cache;
   HASHCODE hashcode   = vtree->key_hashcode;
   BYTE* key           = vtree->key;
   c2dSize key_size    = vtree->key_size;
-  c2dSize index       = hashcode % cache->capacity;
-  VtreeCE* head_entry = cache->buckets[index]; //head of collision list
-  
-  //create entry
-  VtreeCE* entry   = (VtreeCE*) malloc(sizeof(VtreeCE));
-  entry->value     = item;
-  entry->vtree     = vtree;
-  entry->key       = (BYTE*) calloc(key_size,sizeof(BYTE));
-  copy_key(key,entry->key,key_size); //entry key  
-     
-  //insert into hash table
-  entry->next           = head_entry;
-  cache->buckets[index] = entry; 
-  entry->prev_next      = cache->buckets+index;
-  if(head_entry!=NULL) head_entry->prev_next = &(entry->next);
-  
+  c2dSize p           = vtree->position;
+  c2dSize cells       = KEY_RECORD_CELLS(vtree);
+
+  if(cache->vtrees==NULL) construct_vtree_chains(manager);
+  if(cache->count+cache->deleted>=CACHE_MAX_LOAD(cache->capacity)) rebuild_hash_table(cache);
+
+  //create key record (before finding a slot, as the key arena may be compacted)
+  c2dSize offset = new_key_record(cells,cache);
+  copy_key(key,KEY_CELLS(cache,offset),key_size); //entry key
+
+  //insert into hash table (key is not in cache, so a deleted slot can be reused)
+  c2dSize slot    = free_slot(hashcode,cache->table,cache->capacity);
+  VtreeCE* entry  = cache->table+slot;
+  if(entry->vtree==VTREE_CE_DELETED) --cache->deleted;
+  entry->vtree    = (p+1)|VTREE_CE_REFERENCED;
+  entry->key      = offset;
+  entry->value    = item;
+
   //add entry to list of cache entries for vtree
-  entry->vtree_next  = vtree->cache_entry;
-  vtree->cache_entry = entry;
-  
+  VtreeKH* header        = KEY_HEADER(cache,offset);
+  header->slot           = slot;
+  header->vtree_next     = cache->vtree_chains[p];
+  cache->vtree_chains[p] = offset+1;
+
   //update stats
   ++cache->count;
-  cache->memory += sizeof(VtreeCE) + sizeof(BYTE)*vtree->key_size;
+  cache->memory += sizeof(VtreeCE) + cells*sizeof(VtreeKH);
+
+  if(cache->compress_keys)
+    for(c2dSize i=0; i<AGING_RATE; i++) age_cache_entry(0,cache);
+  if(cache->spill!=NULL)
+    while(cache->memory>cache->memory_limit) age_cache_entry(1,cache);
 }
- 
+
 /******************************************************************************
  * dropping entries
  ******************************************************************************/
 
-//remove cache entry from cache
-void drop_cache_entry(VtreeCE* entry, VtreeCache* cache) {
-  //remove from collision list
-  *(entry->prev_next) = entry->next; 
-  if(entry->next!=NULL) entry->next->prev_next = entry->prev_next;
+//remove cache entry (whose key record is at offset) from cache
+void drop_cache_entry(c2dSize offset, const DVtree* vtree, VtreeCache* cache) {
+  VtreeKH* header = KEY_HEADER(cache,offset);
+  c2dSize cells   = record_cells(offset,vtree,cache);
+  if(header->slot&VTREE_KH_PACKED) --cache->packed;
+  //remove from hash table (slot cannot be emptied, as it may be on the probe sequence of other entries)
+  cache->table[VTREE_KH_SLOT(header)].vtree = VTREE_CE_DELETED;
+  ++cache->deleted;
+  //free key record
+  header->slot       = VTREE_KH_DEAD;
+  header->vtree_next = cells;
+  cache->key_garbage += cells;
   //update stats
   --cache->count;
-  cache->memory -= sizeof(VtreeCE) + sizeof(BYTE)*entry->vtree->key_size;
-  //free
-  free_cache_entry(entry);
+  cache->memory -= sizeof(VtreeCE) + cells*sizeof(VtreeKH);
 }
 
 //drop all cache entries of vtree and its descendants
 void drop_vtree_cache_entries(DVtree* vtree, VtreeManager* manager) {
   if(vtree->left==NULL) return;
-  
+
   VtreeCache* cache = manager->cache;
-  VtreeCE* entry    = vtree->cache_entry;
-  
-  while(entry!=NULL) {
-    VtreeCE* next = entry->vtree_next; //next in vtree list of entries
-    drop_cache_entry(entry,cache);
-    entry = next;
+  if(cache->vtrees==NULL) return; //nothing cached yet
+
+  c2dSize p         = vtree->position;
+  unsigned int next = cache->vtree_chains[p];
+
+  while(next!=0) {
+    c2dSize offset = next-1;
+    VtreeKH* header = KEY_HEADER(cache,offset);
+    next = header->vtree_next; //next in vtree list of entries
+    if(header->slot&VTREE_KH_SPILLED) continue; //already removed from cache
+    drop_cache_entry(offset,vtree,cache);
   }
-  vtree->cache_entry = NULL;
-  
+  cache->vtree_chains[p] = 0;
+  if(cache->spill!=NULL) drop_spilled_entries(vtree,cache->spill);
+
   drop_vtree_cache_entries(vtree->left,manager);
   drop_vtree_cache_entries(vtree->right,manager);
 }
- 
+
 /******************************************************************************
  * cache stats
  ******************************************************************************/
 
-void clist_size(VtreeCache* cache, c2dSize* max, double* ave, double* ave_key, double* max_key, double* min_key) {
+void probe_size(VtreeCache* cache, c2dSize* max, double* ave, double* ave_key, double* max_key, double* min_key) {
   *max = 0;
   *ave = 0;
   *ave_key = 0;
   *max_key = 0;
   *min_key = 10000000;
 
-  c2dSize bcount = 0; //number of non-empty buckets
   for(c2dSize i=0; i<cache->capacity; i++) {
-    c2dSize count = 0;
-    VtreeCE* entry = cache->buckets[i];
-    while(entry != NULL) {
-      *ave_key += entry->vtree->key_size;
-      if(entry->vtree->key_size > *max_key) *max_key = entry->vtree->key_size;
-      if(entry->vtree->key_size < *min_key) *min_key = entry->vtree->key_size;
-      ++count;
-      entry = entry->next;
-    }
-    if(count) { //non-empty bucket
-      ++bcount;
-      *ave += count;
-    }
-    if(count > *max) {
-      *max = count;
-    }
+    VtreeCE* entry = cache->table+i;
+    if(!VTREE_CE_LIVE(entry)) continue;
+    DVtree* vtree = cache->vtrees[VTREE_CE_POSITION(entry)];
+    *ave_key += vtree->key_size;
+    if(vtree->key_size > *max_key) *max_key = vtree->key_size;
+    if(vtree->key_size < *min_key) *min_key = vtree->key_size;
+    //distance of entry from its hash table index
+    HASHCODE hashcode = key_hashcode(vtree->position,record_key(entry->key,vtree,cache),vtree->key_size);
+    c2dSize home  = hashcode % cache->capacity;
+    c2dSize count = 1+(i>=home? i-home: i+cache->capacity-home);
+    *ave += count;
+    if(count > *max) *max = count;
   }
-  *ave = *ave/bcount;
+  *ave = *ave/cache->count;
   *ave_key = *ave_key/cache->count;
 }
 
 void print_vtree_cache_stats(VtreeCache* cache) {
-  c2dSize max_cl;
-  double ave_cl;
+  c2dSize max_probe;
+  double ave_probe;
   double ave_key, max_key, min_key;
-  clist_size(cache,&max_cl,&ave_cl,&ave_key,&max_key,&min_key);
-  
+  probe_size(cache,&max_probe,&ave_probe,&ave_key,&max_key,&min_key);
+  c2dSize lookups = cache->hits+cache->misses;
+
   printf("\nCache stats:");
-  printf(     "\n  hit rate   \t%.1f%%",(100.0*cache->hits)/(cache->hits+cache->misses));
-  printf(     "\n  lookups    \t%"PRIvS"",cache->hits+cache->misses);
+  printf(     "\n  hit rate   \t%.1f%%",(100.0*cache->hits)/lookups);
+  printf(     "\n  lookups    \t%"PRIvS"",lookups);
   printf(     "\n  ent count  \t%"PRIvS"",cache->count);
   pprint_bytes("\n  ent memory \t",cache->memory);
-  pprint_bytes("\n  ht  memory \t",cache->capacity*sizeof(VtreeCE*));
-  printf(     "\n  clists     \t%0.1f ave, %"PRIvS" max",ave_cl,max_cl);
+  pprint_bytes("\n  ht  memory \t",cache->capacity*sizeof(VtreeCE));
+  pprint_bytes("\n  key memory \t",cache->key_capacity*sizeof(VtreeKH));
+  printf(     "\n  probes     \t%0.1f ave, %"PRIvS" max (entries), %0.1f ave (lookups)",ave_probe,max_probe,(double)cache->probes/lookups);
   printf(     "\n  keys       \t%.1fb ave, %.1fb max, %.1fb min",ave_key,max_key,min_key);
+  if(cache->compress_keys) printf("\n  compressed \t%"PRIvS" keys",cache->packed);
+  if(cache->spill!=NULL) print_vtree_spill_stats(cache->spill);
 }
 
 /******************************************************************************
- * utilities 
+ * utilities
  ******************************************************************************/
 
 BOOLEAN match_keys(register BYTE* key1, register BYTE* key2, register c2dSize count) {
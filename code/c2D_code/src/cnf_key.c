@@ -28,14 +28,16 @@
  * hashcode
  ******************************************************************************/
  
+//compute a hash code for a key of the vtree node at the given position
+HASHCODE key_hashcode(c2dSize position, const BYTE* key, c2dSize size) {
+  HASHCODE hashcode = position; //was 0
+  while(size--) hashcode = 31*hashcode + *key++;
+  return hashcode;
+}
+
 //compute and store a hash code for the current key associated with vtree
 void set_vtree_hashcode(DVtree* vtree) {
-  c2dSize size = vtree->key_size;
-  BYTE* key    = vtree->key;
-  
-  HASHCODE hashcode = vtree->position; //was 0
-  while(size--) hashcode = 31*hashcode + *key++;
-  vtree->key_hashcode = hashcode;
+  vtree->key_hashcode = key_hashcode(vtree->position,vtree->key,vtree->key_size);
 }
 
 /******************************************************************************
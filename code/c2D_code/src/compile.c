@@ -10,9 +10,12 @@
 BOOLEAN lookup_cache(VtreeCV* item, DVtree* vtree, VtreeManager* manager);
 void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager);
 void drop_vtree_cache_entries(DVtree* vtree, VtreeManager* manager);
+//flat_vtree.c
+FVtree* flatten_vtree(DVtree* vtree);
+void free_flat_vtree(FVtree* nodes);
 
 //local
-void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state);
+void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, const FVtree* vnode, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state);
 
 /******************************************************************************
  * Three compilation cases: leaf nodes, decomposition nodes, and Shannon nodes
@@ -45,16 +48,17 @@ NnfManager* compile_vtree(VtreeManager* manager, SatState* sat_state) {
 
   NNF_NODE node;
   Clause* learned_clause  = NULL;
-  DVtree* vtree           = manager->vtree;
+  FVtree* vnodes          = flatten_vtree(manager->vtree);
   NnfManager* nnf_manager = nnf_manager_new(sat_state,UNIQUE_TABLE_CAPACITY);
 
   if(sat_unit_resolution(sat_state)) { //unit resolution succeeded
-    compile_dispatcher(&node,&learned_clause,vtree,manager,nnf_manager,sat_state);
+    compile_dispatcher(&node,&learned_clause,vnodes,manager,nnf_manager,sat_state);
     if(learned_clause!=NULL) node = ZERO_NNF_NODE; //cnf is inconsistent
   }
   else node = ZERO_NNF_NODE; //cnf is inconsistent
 
   sat_undo_unit_resolution(sat_state);
+  free_flat_vtree(vnodes);
   nnf_manager_set_root(node,nnf_manager);
   return nnf_manager;
 }
@@ -75,9 +79,9 @@ NNF_NODE var2nnf(Var* var, NnfManager* nnf_manager) {
   else return ONE_NNF_NODE;
 }
 
-void compile_vtree_leaf(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, NnfManager* nnf_manager) {
-  assert(vtree_is_leaf(vtree));
-  *node = var2nnf(vtree->var,nnf_manager);
+void compile_vtree_leaf(NNF_NODE* node, Clause** learned_clause, const FVtree* vnode, NnfManager* nnf_manager) {
+  assert(FV_IS_LEAF(vnode));
+  *node = var2nnf(vnode->var,nnf_manager);
   *learned_clause = NULL;
 }
 
@@ -85,19 +89,19 @@ void compile_vtree_leaf(NNF_NODE* node, Clause** learned_clause, DVtree* vtree,
  * Case II: decomposition node (left and right vtrees are independent)
  ******************************************************************************/
 
-void compile_vtree_decomposed(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+void compile_vtree_decomposed(NNF_NODE* node, Clause** learned_clause, const FVtree* vnode, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
 
   NNF_NODE l_node;
-  compile_dispatcher(&l_node,learned_clause,vtree->left,vtree_manager,nnf_manager,sat_state);
+  compile_dispatcher(&l_node,learned_clause,FV_LEFT(vnode),vtree_manager,nnf_manager,sat_state);
   if(*learned_clause!=NULL) {
-    drop_vtree_cache_entries(vtree->left,vtree_manager);
+    drop_vtree_cache_entries(vnode->vtree->left,vtree_manager);
     return;
   }
 
   NNF_NODE r_node;
-  compile_dispatcher(&r_node,learned_clause,vtree->right,vtree_manager,nnf_manager,sat_state);
+  compile_dispatcher(&r_node,learned_clause,FV_RIGHT(vnode),vtree_manager,nnf_manager,sat_state);
   if(*learned_clause!=NULL) {
-    drop_vtree_cache_entries(vtree,vtree_manager);
+    drop_vtree_cache_entries(vnode->vtree,vtree_manager);
     return;
   }
 
@@ -109,30 +113,30 @@ void compile_vtree_decomposed(NNF_NODE* node, Clause** learned_clause, DVtree* v
  * Case III: Shannon node (compilation based on case analysis)
  ******************************************************************************/
 
-void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state);
+void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, const FVtree* vnode, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state);
 
 static inline
-BOOLEAN compile_with_literal(NNF_NODE* node, Clause** learned_clause, Lit* literal, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+BOOLEAN compile_with_literal(NNF_NODE* node, Clause** learned_clause, Lit* literal, const FVtree* vnode, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
   *learned_clause     = sat_decide_literal(literal,sat_state);
-  if(*learned_clause==NULL) compile_dispatcher(node,learned_clause,vtree->right,vtree_manager,nnf_manager,sat_state);
+  if(*learned_clause==NULL) compile_dispatcher(node,learned_clause,FV_RIGHT(vnode),vtree_manager,nnf_manager,sat_state);
   sat_undo_decide_literal(sat_state);
   if(*learned_clause!=NULL) { //a clause was learned
     if(sat_at_assertion_level(*learned_clause,sat_state)) {
       *learned_clause = sat_assert_clause(*learned_clause,sat_state);
       //if another clause was learned, its assertion level must be lower (hence, we must backtrack)
       //if another clause was not learned, then we are ready to try vtree again (with the learned clause)
-      if(*learned_clause==NULL) compile_vtree_shannon(node,learned_clause,vtree,vtree_manager,nnf_manager,sat_state);
+      if(*learned_clause==NULL) compile_vtree_shannon(node,learned_clause,vnode,vtree_manager,nnf_manager,sat_state);
     }
     return 0; //compiling with literal failed as it led to learning at least one clause
   }
   else return 1; //compiling with literal succeeded without learning clauses
 }
 
-void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
-  Var* var = vtree_shannon_var(vtree);
+void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, const FVtree* vnode, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+  Var* var = vnode->var;
 
   if(sat_instantiated_var(var) || sat_irrelevant_var(var)) {
-    compile_dispatcher(node,learned_clause,vtree->right,vtree_manager,nnf_manager,sat_state);
+    compile_dispatcher(node,learned_clause,FV_RIGHT(vnode),vtree_manager,nnf_manager,sat_state);
     if(*learned_clause==NULL) *node = nnf_conjoin(*node,var2nnf(var,nnf_manager),nnf_manager);
     return;
   }
@@ -140,12 +144,12 @@ void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtre
   Lit* plit           = sat_pos_literal(var);
   Lit* nlit           = sat_neg_literal(var);
 
-  if(!compile_with_literal(node,learned_clause,plit,vtree,vtree_manager,nnf_manager,sat_state)) return;
+  if(!compile_with_literal(node,learned_clause,plit,vnode,vtree_manager,nnf_manager,sat_state)) return;
   assert(*learned_clause==NULL);
   assert(!sat_instantiated_var(var));
   NNF_NODE pnode = *node; //save the node when conditioned on plit
 
-  if(!compile_with_literal(node,learned_clause,nlit,vtree,vtree_manager,nnf_manager,sat_state)) return;
+  if(!compile_with_literal(node,learned_clause,nlit,vnode,vtree_manager,nnf_manager,sat_state)) return;
   assert(*learned_clause==NULL);
   assert(!sat_instantiated_var(var));
   NNF_NODE nnode = *node; //save the node when conditioned on nlit
@@ -164,28 +168,33 @@ void compile_vtree_shannon(NNF_NODE* node, Clause** learned_clause, DVtree* vtre
  * Compiler dispatcher
  ******************************************************************************/
 
-void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+void compile_dispatcher(NNF_NODE* node, Clause** learned_clause, const FVtree* vnode, VtreeManager* vtree_manager, NnfManager* nnf_manager, SatState* sat_state) {
+
+  //leaves are not cached
+  if(FV_IS_LEAF(vnode)) {
+    compile_vtree_leaf(node,learned_clause,vnode,nnf_manager);
+    return;
+  }
 
   //check cache
   VtreeCV item;
-  if(lookup_cache(&item,vtree,vtree_manager)) {
+  BOOLEAN cache = FV_SHOULD_CACHE(vnode);
+  if(cache && lookup_cache(&item,vnode->vtree,vtree_manager)) {
     *node = item.node;
     *learned_clause = NULL;
     return;
   }
 
   //need to compile
-  if(vtree_is_leaf(vtree))
-    compile_vtree_leaf(node,learned_clause,vtree,nnf_manager);
-  else if(vtree_is_shannon_node(vtree))
-    compile_vtree_shannon(node,learned_clause,vtree,vtree_manager,nnf_manager,sat_state);
+  if(FV_IS_SHANNON(vnode))
+    compile_vtree_shannon(node,learned_clause,vnode,vtree_manager,nnf_manager,sat_state);
   else
-    compile_vtree_decomposed(node,learned_clause,vtree,vtree_manager,nnf_manager,sat_state);
+    compile_vtree_decomposed(node,learned_clause,vnode,vtree_manager,nnf_manager,sat_state);
 
-  //cache if a node is returned
-  if(*learned_clause==NULL) { //otherwise, a node has not been returned
+  //cache if a node is returned (and learned clauses have not instantiated the Shannon variable)
+  if(*learned_clause==NULL && cache && FV_SHOULD_CACHE(vnode)) { //otherwise, a node has not been returned
     item.node = *node;
-    insert_cache(item,vtree,vtree_manager);
+    insert_cache(item,vnode->vtree,vtree_manager);
   }
 }
 
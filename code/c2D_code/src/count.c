@@ -4,15 +4,38 @@
  * http://reasoning.cs.ucla.edu/c2d
  ******************************************************************************/
 
+#include <math.h>
+#include <signal.h>
 #include "c2d.h"
 
 //cache.c
 BOOLEAN lookup_cache(VtreeCV* item, DVtree* vtree, VtreeManager* manager);
 void insert_cache(VtreeCV item, DVtree* vtree, VtreeManager* manager);
 void drop_vtree_cache_entries(DVtree* vtree, VtreeManager* manager);
+//flat_vtree.c
+FVtree* flatten_vtree(DVtree* vtree);
+void flag_projected_vtree(FVtree* nodes, const BOOLEAN* projected);
+void free_flat_vtree(FVtree* nodes);
+//cubes.c
+c2dWmc count_vtree_cubes(c2dSize k, c2dSize worker_count, BOOLEAN deterministic, const FVtree* nodes, VtreeManager* manager, SatState* sat_state);
+//truth_table.c
+void tt_setup(const SatState* sat_state, c2dSize threshold);
+void tt_teardown();
+BOOLEAN tt_count_vtree(c2dWmc* count, const FVtree* node);
+//anytime.c
+extern volatile sig_atomic_t anytime_report;
+extern volatile sig_atomic_t anytime_terminate;
+void anytime_start(unsigned int seconds);
+void anytime_stop();
 
 //local
-void count_dispatcher(c2dWmc* count, Clause** learned_clause, DVtree* vtree, VtreeManager* manager, SatState* sat_state);
+c2dWmc var2count(Var* var);
+void count_dispatcher(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* manager, SatState* sat_state);
+void count_dispatcher_max(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* manager, SatState* sat_state);
+void count_dispatcher_log(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* manager, SatState* sat_state);
+Clause* decode_mpe_model(const FVtree* nodes, VtreeManager* manager, SatState* sat_state);
+void bounds_setup(const FVtree* nodes);
+void bounds_teardown();
 
 /******************************************************************************
  * Three counting cases: leaf nodes, decomposition nodes, and Shannon nodes
@@ -23,6 +46,7 @@ void count_dispatcher(c2dWmc* count, Clause** learned_clause, DVtree* vtree, Vtr
  * --if *learned_clause==NULL, then *count contains the corresponding model count
  * --if *learned_clause!=NULL, then a clause was learned and counting was aborted
  *   (that is, *count is not meaningful)
+ * --if threshold_reached, then counting was aborted (*count is not meaningful)
  *
  * When a clause is learned during the counting process, the learned clause must
  * be asserted (and all learned clauses it leads to must also be asserted) before
@@ -34,19 +58,86 @@ void count_dispatcher(c2dWmc* count, Clause** learned_clause, DVtree* vtree, Vtr
  * Main (weighted) model counting code
  ******************************************************************************/
 
-c2dWmc count_vtree(VtreeManager* manager, SatState* sat_state) {
+//maximum number of free variables of a vtree counted using a truth table (0 disables)
+static c2dSize tt_max_vars;
+
+//projected[i] is 1 if the variable with index i is a projection variable (NULL if counting is not projected)
+static const BOOLEAN* projected;
+
+void set_count_projection(const BOOLEAN* set) {
+  projected = set;
+}
+
+/******************************************************************************
+ * Bounded counting: counting stops once the count of the cnf is known to be at
+ * least a threshold
+ *
+ * each node is counted with a bound: if the count of the node reaches its bound,
+ * then the count of the cnf reaches the threshold (given the counts already known
+ * at the ancestors of the node). the bound of the root is the threshold, and
+ * --the bound of a Shannon node is divided by the weight of the literal it
+ *   decides, after subtracting the (weighted) count of the first literal
+ * --the bound of the right child of a decomposition node is divided by the count
+ *   of its left child (the left child is unbounded, as the right one may count 0)
+ *
+ * once a bound is reached, the counting stack is unwound without caching: only
+ * exact counts are cached. weights are assumed to be non-negative
+ ******************************************************************************/
+
+static BOOLEAN threshold_reached;
+
+BOOLEAN count_threshold_reached() {
+  return threshold_reached;
+}
+
+//bound of a node whose count is multiplied by weight
+static inline
+c2dWmc scale_bound(c2dWmc bound, c2dWmc weight) {
+  return weight>0? bound/weight: INFINITY;
+}
+
+c2dWmc count_vtree(VtreeManager* manager, SatState* sat_state, const c2dOptions* options) {
 
   c2dWmc count;
   Clause* learned_clause = NULL;
-  DVtree* vtree          = manager->vtree;
+  FVtree* nodes          = flatten_vtree(manager->vtree);
+  c2dWmc bound           = options->threshold>0? options->threshold: INFINITY;
+  threshold_reached      = 0;
+
+  //truth tables count auxiliary variables, and sum weights
+  tt_max_vars = projected==NULL && options->semiring=='s'? options->tt_vars: 0;
+  if(projected!=NULL) flag_projected_vtree(nodes,projected);
+  if(tt_max_vars) tt_setup(sat_state,tt_max_vars);
+  bounds_setup(nodes);
+  if(options->bounds_interval>0) anytime_start(options->bounds_interval);
 
   if(sat_unit_resolution(sat_state)) { //unit resolution succeeded
-    count_dispatcher(&count,&learned_clause,vtree,manager,sat_state);
-    if(learned_clause!=NULL) count = 0; //cnf is inconsistent
+    if(options->cube_vars>0) count = count_vtree_cubes(options->cube_vars,options->workers,options->deterministic,nodes,manager,sat_state);
+    else if(options->semiring=='m') {
+      count_dispatcher_max(&count,&learned_clause,nodes,INFINITY,manager,sat_state);
+      if(learned_clause!=NULL) count = 0; //cnf is inconsistent
+      else {
+        learned_clause = decode_mpe_model(nodes,manager,sat_state);
+        assert(learned_clause==NULL); //cnf is consistent
+      }
+    }
+    else if(options->semiring=='l') {
+      count_dispatcher_log(&count,&learned_clause,nodes,INFINITY,manager,sat_state);
+      if(learned_clause!=NULL) count = -INFINITY; //cnf is inconsistent
+    }
+    else {
+      count_dispatcher(&count,&learned_clause,nodes,bound,manager,sat_state);
+      if(threshold_reached) count = bound; //a lower bound
+      else if(learned_clause!=NULL) count = 0; //cnf is inconsistent
+    }
   }
-  else count = 0; //cnf is inconsistent
+  else count = options->semiring=='l'? -INFINITY: 0; //cnf is inconsistent
 
   sat_undo_unit_resolution(sat_state);
+  if(options->bounds_interval>0) anytime_stop();
+  if(tt_max_vars) tt_teardown();
+  bounds_teardown();
+  free_flat_vtree(nodes);
   return count;
 }
 
@@ -55,126 +146,253 @@ c2dWmc count_vtree(VtreeManager* manager, SatState* sat_state) {
  ******************************************************************************/
 
 /******************************************************************************
- * Case I: leaf vtree (count depends on state of associated variable)
+ * Projected counting: the vtree is constrained so that projection variables are
+ * decided above auxiliary ones (see projection.c). a vtree node without projection
+ * variables is below the frontier, and its count is 1 if its cnf is satisfiable
+ * (0 otherwise): auxiliary variables have weight 1, and a Shannon node below the
+ * frontier stops at the first literal that leads to a count of 1
  ******************************************************************************/
 
-c2dWmc var2count(Var* var) {
-  Lit* plit = sat_pos_literal(var);
-  Lit* nlit = sat_neg_literal(var);
-  if(sat_implied_literal(plit))       return sat_literal_weight(plit);
-  else if(sat_implied_literal(nlit))  return sat_literal_weight(nlit);
-  else return (sat_literal_weight(plit) + sat_literal_weight(nlit));
-}
-
-void count_vtree_leaf(c2dWmc* count, Clause** learned_clause, DVtree* vtree) {
-  assert(vtree_is_leaf(vtree));
-  *count = var2count(vtree->var);
-  *learned_clause = NULL;
-}
+#define AUXILIARY_VAR(var) (projected!=NULL && !projected[sat_var_index(var)])
 
 /******************************************************************************
- * Case II: decomposition node (left and right vtrees are independent)
+ * Anytime bounds: lower and upper bounds on the count of the cnf while counting
+ *
+ * each internal vtree node being counted has a frame (on the C stack), which
+ * bounds its count using the bounds of the child being counted:
+ *   lower bound = lo_known + lo_factor*(lower bound of child)
+ *   upper bound = hi_known + hi_factor*(upper bound of child)
+ * --a Shannon node counting its first literal bounds the second by the total
+ *   weight of the variables of its right child (free_bounds)
+ * --a decomposition node counting its left child has no lower bound (the right
+ *   child may count 0), and bounds the right child by free_bounds
+ * --the count of a first literal (or left child) is known while counting the
+ *   second literal (or right child)
+ *
+ * bounds are requested by signals (see anytime.c), and reported as the counter
+ * enters a vtree node: the count of that node is between 0 and the weights of its
+ * variables (under the current setting), and the frames compose these bounds up
+ * to the root
  ******************************************************************************/
 
-void count_vtree_decomposed(c2dWmc* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
-
-  c2dWmc l_count;
-  count_dispatcher(&l_count,learned_clause,vtree->left,vtree_manager,sat_state);
-  if(*learned_clause!=NULL) {
-    drop_vtree_cache_entries(vtree->left,vtree_manager);
-    return;
-  }
-  else if(l_count==0) { //optimization
-    *count = 0;
-    return;
+typedef struct count_frame_t {
+  c2dWmc lo_known;
+  c2dWmc lo_factor;
+  c2dWmc hi_known;
+  c2dWmc hi_factor;
+  struct count_frame_t* parent;
+} CountFrame;
+
+static CountFrame* top_frame;  //frame of the node being counted (NULL before the root)
+static const FVtree* fv_nodes; //the flattened vtree
+static c2dWmc* free_bounds;    //free_bounds[i]: total weight of the variables of fv_nodes[i]
+static clock_t count_start;
+
+#define FREE_BOUND(node) free_bounds[(node)-fv_nodes]
+
+#define SET_FRAME(lk,lf,hk,hf) do { \
+  top_frame->lo_known  = (lk); \
+  top_frame->lo_factor = (lf); \
+  top_frame->hi_known  = (hk); \
+  top_frame->hi_factor = (hf); \
+} while(0)
+
+void bounds_setup(const FVtree* nodes) {
+  c2dSize count = 2*nodes->var_count-1;
+  fv_nodes      = nodes;
+  top_frame     = NULL;
+  count_start   = clock();
+  free_bounds   = (c2dWmc*) malloc(count*sizeof(c2dWmc));
+  for(c2dSize i=count; i-->0;) { //children follow their parents
+    const FVtree* node = nodes+i;
+    if(!FV_IS_LEAF(node)) free_bounds[i] = free_bounds[i+node->left]*free_bounds[i+node->right];
+    else if(AUXILIARY_VAR(node->var)) free_bounds[i] = 1;
+    else free_bounds[i] = sat_literal_weight(sat_pos_literal(node->var))+sat_literal_weight(sat_neg_literal(node->var));
   }
+}
 
-  c2dWmc r_count;
-  count_dispatcher(&r_count,learned_clause,vtree->right,vtree_manager,sat_state);
-  if(*learned_clause!=NULL) {
-    drop_vtree_cache_entries(vtree,vtree_manager);
-    return;
-  }
+void bounds_teardown() {
+  free(free_bounds);
+}
 
-  assert(*learned_clause==NULL);
-  *count = l_count*r_count;
+//prints bounds on the count of the cnf, when the counter enters node
+static void report_bounds(const FVtree* node) {
+  c2dWmc lower = 0;
+  c2dWmc upper = 1;
+  for(const FVtree* leaf=node; leaf<FV_END(node); leaf++)
+    if(FV_IS_LEAF(leaf)) upper *= var2count(leaf->var);
+  for(const CountFrame* frame=top_frame; frame!=NULL; frame=frame->parent) {
+    lower = frame->lo_known+frame->lo_factor*lower;
+    upper = frame->hi_factor==0? frame->hi_known: frame->hi_known+frame->hi_factor*upper;
+  }
+  anytime_report = 0;
+  printf("\n  Bounds\t%0.3"PRIwmcS" <= count <= %0.3"PRIwmcS" (%0.3fs)",lower,upper,((double)(clock()-count_start))/CLOCKS_PER_SEC);
+  fflush(stdout);
+  if(anytime_terminate) {
+    printf("\nCounting terminated\n\n");
+    exit(1);
+  }
 }
 
 /******************************************************************************
- * Case III: Shannon node (count based on case analysis)
+ * Semirings: the counting cases are compiled once per semiring (see count_cases.h)
+ *
+ * --sum-product: the (weighted) model count
+ * --max-product: the largest weight of a model (most probable explanation)
+ * --log-space: the log of the (weighted) model count, which does not underflow
+ *   (log-sum-exp for sums, sums for products)
  ******************************************************************************/
 
-void count_vtree_shannon(c2dWmc* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state);
+//sum-product (functions keep their names)
+#define SR(name)        name
+#define SR_ZERO         0
+#define SR_ONE          1
+#define SR_ADD(a,b)     ((a)+(b))
+#define SR_MUL(a,b)     ((a)*(b))
+#define SR_WEIGHT(lit)  sat_literal_weight(lit)
+#include "count_cases.h"
+#undef SR
+#undef SR_ZERO
+#undef SR_ONE
+#undef SR_ADD
+#undef SR_MUL
+#undef SR_WEIGHT
+
+//max-product (weights are assumed to be non-negative)
+static inline
+c2dWmc max_wmc(c2dWmc a, c2dWmc b) {
+  return a>b? a: b;
+}
 
+#define SR(name)        name##_max
+#define SR_ZERO         0
+#define SR_ONE          1
+#define SR_ADD(a,b)     max_wmc(a,b)
+#define SR_MUL(a,b)     ((a)*(b))
+#define SR_WEIGHT(lit)  sat_literal_weight(lit)
+#include "count_cases.h"
+#undef SR
+#undef SR_ZERO
+#undef SR_ONE
+#undef SR_ADD
+#undef SR_MUL
+#undef SR_WEIGHT
+
+//log-space
 static inline
-BOOLEAN count_with_literal(c2dWmc* count, Clause** learned_clause, Lit* literal, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
-  *learned_clause     = sat_decide_literal(literal,sat_state);
-  if(*learned_clause==NULL) count_dispatcher(count,learned_clause,vtree->right,vtree_manager,sat_state);
-  sat_undo_decide_literal(sat_state);
-  if(*learned_clause!=NULL) { //a clause was learned
-    if(sat_at_assertion_level(*learned_clause,sat_state)) {
-      *learned_clause = sat_assert_clause(*learned_clause,sat_state);
-      //if another clause was learned, its assertion level must be lower (hence, we must backrack)
-      //if another clause was not learned, then we are ready to try vtree again (with the learned clause)
-      if(*learned_clause==NULL) count_vtree_shannon(count,learned_clause,vtree,vtree_manager,sat_state);
-    }
-    return 0; //counting with literal failed as it led to learning at least one clause
-  }
-  else return 1; //counting with literal succeeded without learning clauses
+c2dWmc log_add(c2dWmc a, c2dWmc b) {
+  if(a<b) { c2dWmc t = a; a = b; b = t; }
+  if(b==-INFINITY) return a;
+  return a+log1p(exp(b-a));
 }
 
-void count_vtree_shannon(c2dWmc* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
-  Var* var = vtree_shannon_var(vtree);
+#define SR(name)        name##_log
+#define SR_ZERO         (-INFINITY)
+#define SR_ONE          0
+#define SR_ADD(a,b)     log_add(a,b)
+#define SR_MUL(a,b)     ((a)+(b))
+#define SR_WEIGHT(lit)  log(sat_literal_weight(lit))
+#include "count_cases.h"
+#undef SR
+#undef SR_ZERO
+#undef SR_ONE
+#undef SR_ADD
+#undef SR_MUL
+#undef SR_WEIGHT
 
-  if(sat_instantiated_var(var) || sat_irrelevant_var(var)) {
-    count_dispatcher(count,learned_clause,vtree->right,vtree_manager,sat_state);
-    if(*learned_clause==NULL) *count *= var2count(var);
-    return;
-  }
+/******************************************************************************
+ * Most probable explanation: a model of largest weight, decoded after max-product
+ * counting by following the largest values down the vtree
+ *
+ * at a Shannon node, both literals are valued again (mostly by cache hits), and
+ * the larger one is decided before decoding the right child. learned clauses are
+ * handled as when counting: decoding backtracks to their assertion level, asserts
+ * them, and decodes the node again
+ ******************************************************************************/
+
+static c2dLiteral* mpe_literals; //mpe_literals[i]: literal of the variable with index i in the model
+static c2dSize mpe_var_count;
 
+//sets the variable to its implied literal, or to the literal of larger weight if it is free
+static void assign_mpe(Var* var) {
   Lit* plit = sat_pos_literal(var);
   Lit* nlit = sat_neg_literal(var);
+  c2dLiteral index = sat_var_index(var);
+  if(sat_implied_literal(plit))      mpe_literals[index] = index;
+  else if(sat_implied_literal(nlit)) mpe_literals[index] = -index;
+  else mpe_literals[index] = sat_literal_weight(plit)>=sat_literal_weight(nlit)? index: -index;
+}
 
-  if(!count_with_literal(count,learned_clause,plit,vtree,vtree_manager,sat_state)) return;
-  assert(*learned_clause==NULL);
-  assert(!sat_instantiated_var(var));
-  c2dWmc pcount = *count; //save count conditioned on plit
-
-  if(!count_with_literal(count,learned_clause,nlit,vtree,vtree_manager,sat_state)) return;
-  assert(*learned_clause==NULL);
-  assert(!sat_instantiated_var(var));
-  c2dWmc ncount = *count; //save count conditioned on nlit
+static Clause* decode_mpe(const FVtree* node, VtreeManager* vtree_manager, SatState* sat_state);
 
-  *count = (pcount*sat_literal_weight(plit)) + (ncount*sat_literal_weight(nlit));
+static Clause* decode_with_literal(Lit* literal, const FVtree* node, VtreeManager* vtree_manager, SatState* sat_state) {
+  Clause* learned_clause = sat_decide_literal(literal,sat_state);
+  if(learned_clause==NULL) {
+    assign_mpe(node->var);
+    learned_clause = decode_mpe(FV_RIGHT(node),vtree_manager,sat_state);
+  }
+  sat_undo_decide_literal(sat_state);
+  if(learned_clause!=NULL && sat_at_assertion_level(learned_clause,sat_state)) {
+    learned_clause = sat_assert_clause(learned_clause,sat_state);
+    if(learned_clause==NULL) return decode_mpe(node,vtree_manager,sat_state);
+  }
+  return learned_clause;
 }
 
-/******************************************************************************
- * Count dispatcher
- ******************************************************************************/
-
-void count_dispatcher(c2dWmc* count, Clause** learned_clause, DVtree* vtree, VtreeManager* vtree_manager, SatState* sat_state) {
+//returns NULL after setting the variables of node in mpe_literals, or a learned clause
+static Clause* decode_mpe(const FVtree* node, VtreeManager* vtree_manager, SatState* sat_state) {
+  if(FV_IS_LEAF(node)) {
+    assign_mpe(node->var);
+    return NULL;
+  }
+  if(!FV_IS_SHANNON(node)) {
+    Clause* learned_clause = decode_mpe(FV_LEFT(node),vtree_manager,sat_state);
+    if(learned_clause!=NULL) return learned_clause;
+    return decode_mpe(FV_RIGHT(node),vtree_manager,sat_state);
+  }
 
-  //check cache
-  VtreeCV item;
-  if(lookup_cache(&item,vtree,vtree_manager)) {
-    *count = item.count;
-    *learned_clause = NULL;
-    return;
+  Var* var = node->var;
+  if(sat_instantiated_var(var) || sat_irrelevant_var(var)) {
+    assign_mpe(var);
+    return decode_mpe(FV_RIGHT(node),vtree_manager,sat_state);
   }
 
-  //need to count
-  if(vtree_is_leaf(vtree))
-    count_vtree_leaf(count,learned_clause,vtree);
-  else if(vtree_is_shannon_node(vtree))
-    count_vtree_shannon(count,learned_clause,vtree,vtree_manager,sat_state);
-  else
-    count_vtree_decomposed(count,learned_clause,vtree,vtree_manager,sat_state);
-
-  //cache if a count is returned
-  if(*learned_clause==NULL) { //otherwise, a count has not been returned
-    item.count = *count;
-    insert_cache(item,vtree,vtree_manager);
+  Lit* plit = sat_pos_literal(var);
+  Lit* nlit = sat_neg_literal(var);
+  c2dWmc pcount, ncount;
+  Clause* learned_clause;
+  //a clause asserted at the level of node counts node again, which sets its frame
+  CountFrame frame;
+  frame.parent = top_frame;
+  top_frame    = &frame;
+  SET_FRAME(0,1,0,1);
+  BOOLEAN counted = count_with_literal_max(&pcount,&learned_clause,plit,node,INFINITY,INFINITY,vtree_manager,sat_state) &&
+                    count_with_literal_max(&ncount,&learned_clause,nlit,node,INFINITY,INFINITY,vtree_manager,sat_state);
+  top_frame = frame.parent;
+  if(!counted) {
+    //a clause was learned: backtrack, or decode again with the asserted clause
+    return learned_clause!=NULL? learned_clause: decode_mpe(node,vtree_manager,sat_state);
   }
+  pcount *= sat_literal_weight(plit);
+  ncount *= sat_literal_weight(nlit);
+  return decode_with_literal(pcount>=ncount? plit: nlit,node,vtree_manager,sat_state);
+}
+
+//returns NULL after decoding a model of the vtree (nodes) whose weight is its max-product count
+Clause* decode_mpe_model(const FVtree* nodes, VtreeManager* manager, SatState* sat_state) {
+  mpe_var_count = sat_var_count(sat_state);
+  mpe_literals  = (c2dLiteral*) calloc(mpe_var_count+1,sizeof(c2dLiteral));
+  return decode_mpe(nodes,manager,sat_state);
+}
+
+//prints the model found by decode_mpe_model (none if the cnf is inconsistent)
+void print_mpe_model() {
+  if(mpe_literals==NULL) return;
+  printf("\n  MPE model\t");
+  for(c2dSize i=1; i<=mpe_var_count; i++) printf("%ld ",mpe_literals[i]);
+  printf("0");
+  free(mpe_literals);
+  mpe_literals = NULL;
 }
 
 /******************************************************************************
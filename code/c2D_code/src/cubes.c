@@ -0,0 +1,471 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _GNU_SOURCE //fork, pipe, select, kill, sched_setaffinity
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+#include <math.h>
+#include "c2d.h"
+
+//count.c
+void count_dispatcher(c2dWmc* count, Clause** learned_clause, const FVtree* node, c2dWmc bound, VtreeManager* manager, SatState* sat_state);
+//cache.c
+void interleave_vtree_cache(VtreeManager* manager);
+void fork_vtree_cache(VtreeManager* manager);
+
+/******************************************************************************
+ * counting by top-level case splitting:
+ *
+ * --the top k Shannon variables of the vtree (in breadth-first order) are picked,
+ *   and the cnf is counted under each of their 2^k assignments (cubes)
+ * --a cube is counted by deciding its literals at the root, then counting the
+ *   vtree as usual: counts of instantiated variables include their weights, so
+ *   the count of the cnf is the sum of the counts of its cubes
+ * --cubes are either counted in this process, one after the other, or dispatched
+ *   to worker processes (forked after unit resolution, so they share the sat
+ *   state and vtree manager as constructed)
+ *
+ * workers are reached over pipes, using fixed size messages: the coordinator
+ * sends the index of a cube, and the worker replies with the index and count of
+ * the cube. the same messages can be carried over sockets to workers on other
+ * machines
+ *
+ * the coordinator hands the next cube to an idle worker. once all cubes are
+ * handed out, an idle worker is given a copy of the oldest cube still being
+ * counted (a straggler), and the first reply for a cube is used. counts are
+ * summed in cube order, so the result does not depend on which worker counted
+ * which cube
+ *
+ * in deterministic mode, the work of each worker does not depend on timing
+ * either: worker w counts cubes w, w+P, w+2P, ... (for P workers) in this order,
+ * and stragglers are not reassigned. each worker then goes through the same
+ * sequence of states (learned clauses, cache entries) in every run. the work of
+ * counting a cube is measured by cache lookups rather than time, so runs can be
+ * compared by their work
+ *
+ * on NUMA machines, workers are spread round-robin over the nodes the process may
+ * run on (as restricted by taskset or numactl), and each worker is pinned to the
+ * cpus of its node right after the fork, before it writes any page: the pages of
+ * the sat state and cache it copies on write, and its scratch keys, then land on
+ * its node. the cache tables, which all workers read as filled before the fork,
+ * are interleaved over the nodes (see huge.c of the sat library). an idle worker
+ * prefers a straggler being counted on its own node, whose pages (shared until
+ * written) are then likely in the cache of that node
+ ******************************************************************************/
+
+//a straggler is counted by at most this many workers at a time
+#define MAX_CUBE_COPIES 2
+
+//NUMA nodes of the machine (see /sys/devices/system/node)
+#define NUMA_NODE_PATH "/sys/devices/system/node"
+#define MAX_NUMA_NODES 64
+
+typedef struct {
+  unsigned int cube;
+  c2dWmc count;
+  c2dSize work;   //cache lookups made while counting cube
+} CubeResult;
+
+static Var* cube_vars[MAX_CUBE_VARS];
+static c2dSize cube_var_count;
+static BOOLEAN inconsistent; //a clause learned while counting a cube showed the cnf is inconsistent
+static BOOLEAN deterministic;
+
+/******************************************************************************
+ * picking cube variables
+ ******************************************************************************/
+
+//pick the top k free Shannon variables of the vtree (breadth-first)
+static void pick_cube_vars(const FVtree* nodes, c2dSize k) {
+  const FVtree** queue = (const FVtree**) malloc(nodes->var_count*sizeof(const FVtree*));
+  c2dSize head = 0;
+  c2dSize tail = 0;
+  cube_var_count = 0;
+  if(!FV_IS_LEAF(nodes)) queue[tail++] = nodes;
+  while(head<tail && cube_var_count<k) {
+    const FVtree* node = queue[head++];
+    if(FV_IS_SHANNON(node) && !sat_instantiated_var(node->var))
+      cube_vars[cube_var_count++] = node->var;
+    //queue holds internal nodes only (there are fewer than var_count of them)
+    if(!FV_IS_SHANNON(node) && !FV_IS_LEAF(FV_LEFT(node))) queue[tail++] = FV_LEFT(node);
+    if(!FV_IS_LEAF(FV_RIGHT(node))) queue[tail++] = FV_RIGHT(node);
+  }
+  free(queue);
+}
+
+//the literal of the i^th cube variable in cube
+static inline Lit* cube_literal(c2dSize cube, c2dSize i) {
+  return (cube>>i)&1? sat_pos_literal(cube_vars[i]): sat_neg_literal(cube_vars[i]);
+}
+
+/******************************************************************************
+ * counting a cube
+ ******************************************************************************/
+
+//decide the literals of cube (at the root), count, then undo the decisions
+//
+//a clause learned while deciding or counting is asserted at its assertion level,
+//after which the undone literals of cube are decided again
+static c2dWmc count_cube(c2dSize cube, const FVtree* nodes, VtreeManager* manager, SatState* sat_state) {
+  c2dSize decided_at[MAX_CUBE_VARS]; //index of cube literal of each decision
+  c2dSize decided = 0;
+  c2dSize i       = 0;
+  c2dWmc count    = 0;
+  if(inconsistent) return 0;
+
+  while(1) {
+    Clause* learned_clause = NULL;
+    for(; i<cube_var_count && learned_clause==NULL; i++) {
+      Lit* lit = cube_literal(cube,i);
+      Var* var = cube_vars[i];
+      if(sat_implied_literal(lit)) continue;
+      if(sat_instantiated_var(var)) { //cube is inconsistent with cnf
+        count = 0;
+        goto done;
+      }
+      learned_clause = sat_decide_literal(lit,sat_state);
+      decided_at[decided++] = i;
+    }
+    if(learned_clause==NULL) count_dispatcher(&count,&learned_clause,nodes,INFINITY,manager,sat_state);
+    if(learned_clause==NULL) break; //cube was counted
+
+    //backtrack to the assertion level of learned clause, and assert it
+    while(learned_clause!=NULL) {
+      while(decided>0 && !sat_at_assertion_level(learned_clause,sat_state)) {
+        sat_undo_decide_literal(sat_state);
+        --decided;
+      }
+      if(!sat_at_assertion_level(learned_clause,sat_state)) { //cnf is inconsistent
+        inconsistent = 1;
+        count = 0;
+        goto done;
+      }
+      learned_clause = sat_assert_clause(learned_clause,sat_state);
+    }
+    i = decided==0? 0: decided_at[decided-1]+1;
+  }
+
+  done:
+  while(decided>0) {
+    sat_undo_decide_literal(sat_state);
+    --decided;
+  }
+  return count;
+}
+
+static void count_cube_work(CubeResult* result, const FVtree* nodes, VtreeManager* manager, SatState* sat_state) {
+  VtreeCache* cache = manager->cache;
+  c2dSize lookups   = cache->hits+cache->misses;
+  result->count     = count_cube(result->cube,nodes,manager,sat_state);
+  result->work      = cache->hits+cache->misses-lookups;
+}
+
+/******************************************************************************
+ * NUMA nodes of workers
+ ******************************************************************************/
+
+static cpu_set_t node_cpus[MAX_NUMA_NODES]; //cpus of each node that the process may run on
+static c2dSize node_count;                  //0 if workers are not pinned (fewer than two nodes)
+
+//parse a list of cpus or nodes (e.g., 0-3,8-11) into set
+static void parse_list(FILE* file, cpu_set_t* set) {
+  int first, last;
+  char separator;
+  CPU_ZERO(set);
+  while(fscanf(file,"%d",&first)==1) {
+    last = first;
+    separator = fgetc(file);
+    if(separator=='-') {
+      if(fscanf(file,"%d",&last)!=1) break;
+      separator = fgetc(file);
+    }
+    for(int i=first; i<=last && i<CPU_SETSIZE; i++) CPU_SET(i,set);
+    if(separator!=',') break;
+  }
+}
+
+//set node_cpus to the cpus of the online nodes that the process may run on
+static void find_numa_nodes() {
+  cpu_set_t allowed, online;
+  node_count = 0;
+  FILE* file = fopen(NUMA_NODE_PATH "/online","r");
+  if(file==NULL) return;
+  parse_list(file,&online);
+  fclose(file);
+  if(sched_getaffinity(0,sizeof(cpu_set_t),&allowed)!=0) return;
+
+  for(int n=0; n<CPU_SETSIZE && node_count<MAX_NUMA_NODES; n++) {
+    if(!CPU_ISSET(n,&online)) continue;
+    char path[sizeof(NUMA_NODE_PATH)+32];
+    sprintf(path,NUMA_NODE_PATH "/node%d/cpulist",n);
+    if((file=fopen(path,"r"))==NULL) continue;
+    cpu_set_t* cpus = node_cpus+node_count;
+    parse_list(file,cpus);
+    fclose(file);
+    CPU_AND(cpus,cpus,&allowed);
+    if(CPU_COUNT(cpus)>0) ++node_count;
+  }
+  if(node_count<2) node_count = 0;
+}
+
+/******************************************************************************
+ * workers
+ ******************************************************************************/
+
+typedef struct {
+  pid_t pid;
+  int to;       //pipe for sending cubes to worker
+  int from;     //pipe for receiving results from worker
+  long cube;    //cube being counted by worker (-1 if idle)
+  c2dSize next; //next cube of worker (deterministic mode)
+  c2dSize node; //NUMA node of worker (if pinned)
+} CubeWorker;
+
+static BOOLEAN read_fully(int fd, void* buffer, c2dSize size) {
+  char* p = (char*) buffer;
+  while(size>0) {
+    ssize_t n = read(fd,p,size);
+    if(n<=0) return 0;
+    p    += n;
+    size -= n;
+  }
+  return 1;
+}
+
+static BOOLEAN write_fully(int fd, const void* buffer, c2dSize size) {
+  const char* p = (const char*) buffer;
+  while(size>0) {
+    ssize_t n = write(fd,p,size);
+    if(n<=0) return 0;
+    p    += n;
+    size -= n;
+  }
+  return 1;
+}
+
+//count the cubes sent by the coordinator, until the pipe is closed
+static void run_worker(int from, int to, const FVtree* nodes, VtreeManager* manager, SatState* sat_state) {
+  CubeResult result;
+  while(read_fully(from,&result.cube,sizeof(result.cube))) {
+    count_cube_work(&result,nodes,manager,sat_state);
+    if(!write_fully(to,&result,sizeof(CubeResult))) break;
+  }
+  _exit(0);
+}
+
+//start the w^th worker (the pipes of earlier workers are closed in the worker)
+static void start_worker(CubeWorker* workers, c2dSize w, const FVtree* nodes, VtreeManager* manager, SatState* sat_state) {
+  CubeWorker* worker = workers+w;
+  worker->node = node_count>0? w%node_count: 0;
+  int to[2], from[2];
+  if(pipe(to)!=0 || pipe(from)!=0) {
+    fprintf(stderr,"c2D: cannot create pipes for workers\n");
+    exit(1);
+  }
+  fflush(stdout);
+  worker->pid = fork();
+  if(worker->pid<0) {
+    fprintf(stderr,"c2D: cannot fork workers\n");
+    exit(1);
+  }
+  if(worker->pid==0) {
+    for(c2dSize i=0; i<w; i++) {
+      close(workers[i].to);
+      close(workers[i].from);
+    }
+    close(to[1]);
+    close(from[0]);
+    if(node_count>0) sched_setaffinity(0,sizeof(cpu_set_t),node_cpus+worker->node);
+    fork_vtree_cache(manager);
+    run_worker(to[0],from[1],nodes,manager,sat_state);
+  }
+  close(to[0]);
+  close(from[1]);
+  worker->to   = to[1];
+  worker->from = from[0];
+  worker->cube = -1;
+  worker->next = w;
+}
+
+static void stop_worker(CubeWorker* worker) {
+  if(worker->pid<=0) return;
+  if(worker->cube>=0) kill(worker->pid,SIGKILL); //still counting a straggler
+  close(worker->to);
+  close(worker->from);
+  waitpid(worker->pid,NULL,0);
+  worker->pid = 0;
+}
+
+/******************************************************************************
+ * coordinator
+ ******************************************************************************/
+
+//cube counts and work, whether each cube was counted, and the number of workers counting it
+static c2dWmc* cube_counts;
+static c2dSize* cube_work;
+static BYTE* cube_done;
+static BYTE* cube_copies;
+static c2dSize cube_count;
+static c2dSize next_cube;   //next cube not handed out yet
+static c2dSize reassigned;  //stragglers handed to more than one worker
+static c2dSize work;        //cache lookups of counted cubes
+
+//return the oldest straggler being counted by a worker on the node of worker (-1 if none)
+static long pick_node_straggler(const CubeWorker* worker, const CubeWorker* workers, c2dSize worker_count) {
+  long straggler = -1;
+  for(c2dSize w=0; w<worker_count; w++) {
+    long cube = workers[w].cube;
+    if(workers[w].pid<=0 || cube<0 || workers[w].node!=worker->node) continue;
+    if(!cube_done[cube] && cube_copies[cube]<MAX_CUBE_COPIES && (straggler<0 || cube<straggler)) straggler = cube;
+  }
+  return straggler;
+}
+
+//return the cube to be counted by an idle worker (-1 if none)
+static long pick_cube(CubeWorker* worker, const CubeWorker* workers, c2dSize worker_count) {
+  if(deterministic) {
+    if(worker->next>=cube_count) return -1;
+    long cube = worker->next;
+    worker->next += worker_count;
+    return cube;
+  }
+  if(next_cube<cube_count) return next_cube++;
+  long straggler = node_count>0? pick_node_straggler(worker,workers,worker_count): -1;
+  if(straggler>=0) {
+    ++reassigned;
+    return straggler;
+  }
+  for(c2dSize c=0; c<cube_count; c++) //oldest straggler
+    if(!cube_done[c] && cube_copies[c]<MAX_CUBE_COPIES) {
+      if(cube_copies[c]>0) ++reassigned;
+      return c;
+    }
+  return -1;
+}
+
+static void worker_failed(CubeWorker* worker) {
+  fprintf(stderr,"c2D: worker %d failed\n",(int)worker->pid);
+  if(deterministic) exit(1); //its cubes cannot be reassigned
+  worker->cube = -1;
+  stop_worker(worker);
+}
+
+static void assign_cube(CubeWorker* worker, const CubeWorker* workers, c2dSize worker_count) {
+  long cube = pick_cube(worker,workers,worker_count);
+  if(cube<0) return;
+  unsigned int message = cube;
+  if(!write_fully(worker->to,&message,sizeof(message))) {
+    worker_failed(worker);
+    return;
+  }
+  worker->cube = cube;
+  ++cube_copies[cube];
+}
+
+static void count_cubes_with_workers(c2dSize worker_count, const FVtree* nodes, VtreeManager* manager, SatState* sat_state) {
+  CubeWorker* workers = (CubeWorker*) calloc(worker_count,sizeof(CubeWorker));
+  signal(SIGPIPE,SIG_IGN); //failed workers are detected by failed writes
+  find_numa_nodes();
+  if(node_count>0) interleave_vtree_cache(manager);
+  for(c2dSize w=0; w<worker_count; w++) start_worker(workers,w,nodes,manager,sat_state);
+  for(c2dSize w=0; w<worker_count; w++) assign_cube(workers+w,workers,worker_count);
+
+  c2dSize done = 0;
+  while(done<cube_count) {
+    fd_set fds;
+    int max_fd = -1;
+    FD_ZERO(&fds);
+    for(c2dSize w=0; w<worker_count; w++) {
+      if(workers[w].pid<=0 || workers[w].cube<0) continue;
+      FD_SET(workers[w].from,&fds);
+      if(workers[w].from>max_fd) max_fd = workers[w].from;
+    }
+    if(max_fd<0) {
+      fprintf(stderr,"c2D: all workers failed\n");
+      exit(1);
+    }
+    if(select(max_fd+1,&fds,NULL,NULL,NULL)<0) continue; //interrupted
+
+    for(c2dSize w=0; w<worker_count; w++) {
+      CubeWorker* worker = workers+w;
+      if(worker->pid<=0 || worker->cube<0 || !FD_ISSET(worker->from,&fds)) continue;
+      CubeResult result;
+      --cube_copies[worker->cube];
+      if(!read_fully(worker->from,&result,sizeof(CubeResult))) { //its cube is now a straggler
+        worker_failed(worker);
+        continue;
+      }
+      worker->cube = -1;
+      if(!cube_done[result.cube]) {
+        cube_counts[result.cube] = result.count;
+        cube_work[result.cube]   = result.work;
+        cube_done[result.cube]   = 1;
+        ++done;
+      }
+    }
+    for(c2dSize w=0; w<worker_count && done<cube_count; w++)
+      if(workers[w].pid>0 && workers[w].cube<0) assign_cube(workers+w,workers,worker_count);
+  }
+
+  for(c2dSize w=0; w<worker_count; w++) stop_worker(workers+w);
+  free(workers);
+}
+
+/******************************************************************************
+ * counting cubes
+ ******************************************************************************/
+
+//count the cnf (after unit resolution) as the sum of the counts of its cubes
+//cubes are counted by worker_count processes (or by this process if worker_count is 0)
+c2dWmc count_vtree_cubes(c2dSize k, c2dSize worker_count, BOOLEAN determinism, const FVtree* nodes, VtreeManager* manager, SatState* sat_state) {
+  pick_cube_vars(nodes,k);
+  deterministic = determinism;
+  cube_count  = 1UL<<cube_var_count;
+  cube_counts = (c2dWmc*) calloc(cube_count,sizeof(c2dWmc));
+  cube_work   = (c2dSize*) calloc(cube_count,sizeof(c2dSize));
+  cube_done   = (BYTE*) calloc(cube_count,sizeof(BYTE));
+  cube_copies = (BYTE*) calloc(cube_count,sizeof(BYTE));
+  next_cube   = 0;
+  reassigned  = 0;
+  inconsistent = 0;
+
+  if(worker_count==0) {
+    for(c2dSize c=0; c<cube_count; c++) {
+      CubeResult result;
+      result.cube = c;
+      count_cube_work(&result,nodes,manager,sat_state);
+      cube_counts[c] = result.count;
+      cube_work[c]   = result.work;
+    }
+  }
+  else count_cubes_with_workers(worker_count,nodes,manager,sat_state);
+
+  c2dWmc count = 0;
+  work = 0;
+  for(c2dSize c=0; c<cube_count; c++) {
+    count += cube_counts[c];
+    work  += cube_work[c];
+  }
+
+  free(cube_counts);
+  free(cube_work);
+  free(cube_done);
+  free(cube_copies);
+  return count;
+}
+
+void print_cube_stats() {
+  printf("\n  Cubes \t%"PRIvS" (%"PRIvS" vars), %"PRIvS" reassigned",cube_count,cube_var_count,reassigned);
+  printf("\n  Cube work\t%"PRIvS" lookups",work);
+  if(node_count>0) printf("\n  Cube nodes\t%"PRIvS" (workers pinned round-robin)",node_count);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
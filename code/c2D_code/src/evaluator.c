@@ -0,0 +1,359 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include <math.h>
+#include "c2d.h"
+
+/******************************************************************************
+ * incremental evaluation of the compiled nnf under changing literal weights:
+ *
+ * --the nnf is read in its file format (children before parents, so node indices
+ *   are a topological order), with links from children to parents
+ * --each node caches its value: a literal has value w(l)/(w(l)+w(-l)), an and-node
+ *   the product of the values of its children, and an or-node their sum. the
+ *   (weighted) model count is the value of the root times the product of
+ *   w(x)+w(-x) over all variables x (its log is kept, as well as the number of
+ *   variables whose weights sum to 0)
+ * --these values do not need the nnf to be smooth: a variable that is missing
+ *   from some child of an or-node contributes a factor of 1 to its value
+ * --changing the weights of a variable marks its literal nodes dirty. dirty nodes
+ *   are re-evaluated in increasing index (topological) order using a heap, and a
+ *   node whose value changes marks its parents dirty
+ *
+ * an update then re-evaluates only the nodes above the changed literals whose
+ * children changed values (the affected cone), instead of the whole nnf
+ *
+ * the arrays over nodes and edges are huge page regions where available (see
+ * huge.c of the sat library): updates visit nodes scattered across the nnf
+ *
+ * weights are assumed to be non-negative
+ ******************************************************************************/
+
+#define EV_LITERAL 0
+#define EV_AND     1
+#define EV_OR      2
+
+struct nnf_evaluator_t {
+  c2dSize var_count;
+  c2dSize node_count;
+  BYTE* types;             //see above
+  c2dLiteral* literals;    //literals of literal nodes
+  c2dSize* child_start;    //children of node i are children[child_start[i]..child_start[i+1]-1]
+  c2dSize* children;
+  c2dSize* parent_start;   //parents of node i are parents[parent_start[i]..parent_start[i+1]-1]
+  c2dSize* parents;
+  c2dSize* literal_start;  //nodes of literal l are literal_nodes[literal_start[var_count+l]..]
+  c2dSize* literal_nodes;
+  c2dWmc* values;          //cached values of nodes
+  c2dWmc* weights;         //weights[var_count+l]: weight of literal l
+  BOOLEAN* dirty;          //node is in heap
+  c2dSize* heap;           //dirty nodes (min-heap on index)
+  c2dSize heap_size;
+  double log_weights;      //log of the product of w(x)+w(-x) over variables with a positive sum
+  c2dSize zero_vars;       //number of variables x with w(x)+w(-x)=0
+  c2dSize evaluated;       //number of nodes evaluated since the last count
+};
+
+/******************************************************************************
+ * reading the nnf
+ ******************************************************************************/
+
+static void bad_nnf_file(const char* fname) {
+  fprintf(stderr,"c2D: cannot read nnf file %s\n",fname);
+  exit(1);
+}
+
+//reads the nodes and children of the nnf saved in file fname
+static void read_nnf(const char* fname, NnfEvaluator* evaluator) {
+  FILE* fp = fopen(fname,"r");
+  if(fp==NULL) bad_nnf_file(fname);
+
+  c2dSize node_count, edge_count, nnf_vars;
+  char type;
+  //skip comments
+  while(fscanf(fp," %c",&type)==1 && type=='c') {
+    int ch;
+    while((ch = fgetc(fp))!='\n' && ch!=EOF);
+  }
+  if(type!='n' || fscanf(fp,"nf %"PRIvS" %"PRIvS" %"PRIvS"",&node_count,&edge_count,&nnf_vars)!=3 || node_count==0)
+    bad_nnf_file(fname);
+
+  c2dSize var_count       = evaluator->var_count;
+  evaluator->node_count   = node_count;
+  evaluator->types        = (BYTE*) sat_huge_alloc(node_count*sizeof(BYTE));
+  evaluator->literals     = (c2dLiteral*) sat_huge_alloc(node_count*sizeof(c2dLiteral));
+  evaluator->child_start  = (c2dSize*) sat_huge_alloc((node_count+1)*sizeof(c2dSize));
+  evaluator->children     = (c2dSize*) sat_huge_alloc(edge_count*sizeof(c2dSize));
+
+  c2dSize edges = 0;
+  for(c2dSize i=0; i<node_count; i++) {
+    c2dLiteral literal;
+    c2dSize decision, size, child;
+    evaluator->child_start[i] = edges;
+    if(fscanf(fp," %c",&type)!=1) bad_nnf_file(fname);
+    if(type=='L') {
+      if(fscanf(fp,"%ld",&literal)!=1 || literal==0 || literal>(c2dLiteral)var_count || -literal>(c2dLiteral)var_count)
+        bad_nnf_file(fname);
+      evaluator->types[i]    = EV_LITERAL;
+      evaluator->literals[i] = literal;
+    }
+    else if(type=='A' || type=='O') {
+      if(type=='O' && fscanf(fp,"%"PRIvS"",&decision)!=1) bad_nnf_file(fname);
+      if(fscanf(fp,"%"PRIvS"",&size)!=1 || edges+size>edge_count) bad_nnf_file(fname);
+      evaluator->types[i] = type=='A'? EV_AND: EV_OR;
+      for(c2dSize j=0; j<size; j++) {
+        if(fscanf(fp,"%"PRIvS"",&child)!=1 || child>=i) bad_nnf_file(fname);
+        evaluator->children[edges++] = child;
+      }
+    }
+    else bad_nnf_file(fname);
+  }
+  if(edges!=edge_count) bad_nnf_file(fname);
+  evaluator->child_start[node_count] = edges;
+  fclose(fp);
+}
+
+//constructs the parents of nodes, and the nodes of literals (counting sort)
+static void link_nnf(NnfEvaluator* evaluator) {
+  c2dSize node_count  = evaluator->node_count;
+  c2dSize edges       = evaluator->child_start[node_count];
+  c2dSize literals    = 2*evaluator->var_count+1;
+  c2dSize* pstart     = (c2dSize*) sat_huge_alloc((node_count+1)*sizeof(c2dSize));
+  c2dSize* parents    = (c2dSize*) sat_huge_alloc(edges*sizeof(c2dSize));
+  c2dSize* lstart     = (c2dSize*) calloc(literals+1,sizeof(c2dSize));
+  c2dSize* lnodes     = (c2dSize*) sat_huge_alloc(node_count*sizeof(c2dSize));
+
+  for(c2dSize e=0; e<edges; e++) ++pstart[evaluator->children[e]+1];
+  for(c2dSize i=0; i<node_count; i++) pstart[i+1] += pstart[i];
+  c2dSize* next = (c2dSize*) malloc(node_count*sizeof(c2dSize));
+  memcpy(next,pstart,node_count*sizeof(c2dSize));
+  for(c2dSize i=0; i<node_count; i++)
+    for(c2dSize e=evaluator->child_start[i]; e<evaluator->child_start[i+1]; e++)
+      parents[next[evaluator->children[e]]++] = i;
+  free(next);
+
+  for(c2dSize i=0; i<node_count; i++)
+    if(evaluator->types[i]==EV_LITERAL) ++lstart[evaluator->var_count+evaluator->literals[i]+1];
+  for(c2dSize l=0; l<literals; l++) lstart[l+1] += lstart[l];
+  next = (c2dSize*) malloc(literals*sizeof(c2dSize));
+  memcpy(next,lstart,literals*sizeof(c2dSize));
+  for(c2dSize i=0; i<node_count; i++)
+    if(evaluator->types[i]==EV_LITERAL) lnodes[next[evaluator->var_count+evaluator->literals[i]]++] = i;
+  free(next);
+
+  evaluator->parent_start  = pstart;
+  evaluator->parents       = parents;
+  evaluator->literal_start = lstart;
+  evaluator->literal_nodes = lnodes;
+}
+
+/******************************************************************************
+ * evaluating nodes
+ ******************************************************************************/
+
+#define WEIGHT(e,literal) ((e)->weights[(e)->var_count+(literal)])
+
+static c2dWmc evaluate_node(c2dSize node, const NnfEvaluator* evaluator) {
+  const c2dSize* child = evaluator->children+evaluator->child_start[node];
+  const c2dSize* end   = evaluator->children+evaluator->child_start[node+1];
+  const c2dWmc* values = evaluator->values;
+
+  if(evaluator->types[node]==EV_LITERAL) {
+    c2dLiteral literal = evaluator->literals[node];
+    c2dWmc sum = WEIGHT(evaluator,literal)+WEIGHT(evaluator,-literal);
+    return sum>0? WEIGHT(evaluator,literal)/sum: 0;
+  }
+  else if(evaluator->types[node]==EV_AND) {
+    c2dWmc value = 1;
+    for(; child<end && value!=0; child++) value *= values[*child];
+    return value;
+  }
+  else {
+    c2dWmc value = 0;
+    for(; child<end; child++) value += values[*child];
+    return value;
+  }
+}
+
+//adds (sign 1) or removes (sign -1) the factor w(x)+w(-x) of variable x from the count
+static void scale_count(c2dLiteral x, int sign, NnfEvaluator* evaluator) {
+  c2dWmc sum = WEIGHT(evaluator,x)+WEIGHT(evaluator,-x);
+  if(sum>0) evaluator->log_weights += sign*log(sum);
+  else evaluator->zero_vars += sign;
+}
+
+/******************************************************************************
+ * the heap of dirty nodes
+ ******************************************************************************/
+
+static void push_dirty(c2dSize node, NnfEvaluator* evaluator) {
+  if(evaluator->dirty[node]) return;
+  evaluator->dirty[node] = 1;
+  c2dSize* heap = evaluator->heap;
+  c2dSize i     = evaluator->heap_size++;
+  while(i>0 && heap[(i-1)/2]>node) {
+    heap[i] = heap[(i-1)/2];
+    i       = (i-1)/2;
+  }
+  heap[i] = node;
+}
+
+static c2dSize pop_dirty(NnfEvaluator* evaluator) {
+  c2dSize* heap = evaluator->heap;
+  c2dSize top   = heap[0];
+  c2dSize last  = heap[--evaluator->heap_size];
+  c2dSize size  = evaluator->heap_size;
+  c2dSize i     = 0;
+  while(2*i+1<size) {
+    c2dSize child = 2*i+1;
+    if(child+1<size && heap[child+1]<heap[child]) ++child;
+    if(heap[child]>=last) break;
+    heap[i] = heap[child];
+    i       = child;
+  }
+  heap[i] = last;
+  evaluator->dirty[top] = 0;
+  return top;
+}
+
+/******************************************************************************
+ * evaluator interface
+ ******************************************************************************/
+
+//returns an evaluator of the nnf saved in file nnf_fname, with the literal weights of sat_state
+NnfEvaluator* nnf_evaluator_new(const char* nnf_fname, const SatState* sat_state) {
+  NnfEvaluator* evaluator = (NnfEvaluator*) calloc(1,sizeof(NnfEvaluator));
+  c2dSize var_count       = sat_var_count(sat_state);
+  evaluator->var_count    = var_count;
+  read_nnf(nnf_fname,evaluator);
+  link_nnf(evaluator);
+
+  evaluator->weights = (c2dWmc*) calloc(2*var_count+1,sizeof(c2dWmc));
+  for(c2dSize i=1; i<=var_count; i++) {
+    Var* var = sat_index2var(i,sat_state);
+    WEIGHT(evaluator,(c2dLiteral)i)  = sat_literal_weight(sat_pos_literal(var));
+    WEIGHT(evaluator,-(c2dLiteral)i) = sat_literal_weight(sat_neg_literal(var));
+    scale_count(i,1,evaluator);
+  }
+
+  c2dSize node_count = evaluator->node_count;
+  evaluator->values  = (c2dWmc*) sat_huge_alloc(node_count*sizeof(c2dWmc));
+  evaluator->dirty   = (BOOLEAN*) sat_huge_alloc(node_count*sizeof(BOOLEAN));
+  evaluator->heap    = (c2dSize*) sat_huge_alloc(node_count*sizeof(c2dSize));
+  for(c2dSize i=0; i<node_count; i++) evaluator->values[i] = evaluate_node(i,evaluator);
+  evaluator->evaluated = node_count;
+  return evaluator;
+}
+
+void nnf_evaluator_free(NnfEvaluator* evaluator) {
+  c2dSize node_count = evaluator->node_count;
+  c2dSize edge_count = evaluator->child_start[node_count];
+  sat_huge_free(evaluator->types,node_count*sizeof(BYTE));
+  sat_huge_free(evaluator->literals,node_count*sizeof(c2dLiteral));
+  sat_huge_free(evaluator->child_start,(node_count+1)*sizeof(c2dSize));
+  sat_huge_free(evaluator->children,edge_count*sizeof(c2dSize));
+  sat_huge_free(evaluator->parent_start,(node_count+1)*sizeof(c2dSize));
+  sat_huge_free(evaluator->parents,edge_count*sizeof(c2dSize));
+  free(evaluator->literal_start);
+  sat_huge_free(evaluator->literal_nodes,node_count*sizeof(c2dSize));
+  sat_huge_free(evaluator->values,node_count*sizeof(c2dWmc));
+  free(evaluator->weights);
+  sat_huge_free(evaluator->dirty,node_count*sizeof(BOOLEAN));
+  sat_huge_free(evaluator->heap,node_count*sizeof(c2dSize));
+  free(evaluator);
+}
+
+//sets the weight of literal (the count is updated by nnf_evaluator_count)
+void nnf_evaluator_set_weight(c2dLiteral literal, c2dWmc weight, NnfEvaluator* evaluator) {
+  if(WEIGHT(evaluator,literal)==weight) return;
+  c2dLiteral x = literal>0? literal: -literal;
+  scale_count(x,-1,evaluator);
+  WEIGHT(evaluator,literal) = weight;
+  scale_count(x,1,evaluator);
+  //the values of both literals of x change
+  for(c2dSize l=evaluator->var_count-x; l<=evaluator->var_count+x; l += 2*x)
+    for(c2dSize i=evaluator->literal_start[l]; i<evaluator->literal_start[l+1]; i++)
+      push_dirty(evaluator->literal_nodes[i],evaluator);
+}
+
+//returns the (weighted) model count of the nnf under the current weights, after
+//re-evaluating the dirty nodes and the nodes whose children changed values
+c2dWmc nnf_evaluator_count(NnfEvaluator* evaluator) {
+  c2dWmc* values = evaluator->values;
+  while(evaluator->heap_size>0) {
+    c2dSize node = pop_dirty(evaluator);
+    c2dWmc value = evaluate_node(node,evaluator);
+    ++evaluator->evaluated;
+    if(value==values[node]) continue; //the ancestors of node are not affected by it
+    values[node] = value;
+    for(c2dSize i=evaluator->parent_start[node]; i<evaluator->parent_start[node+1]; i++)
+      push_dirty(evaluator->parents[i],evaluator);
+  }
+  if(evaluator->zero_vars>0) return 0;
+  return values[evaluator->node_count-1]*exp(evaluator->log_weights);
+}
+
+//returns the number of nodes evaluated since the last call
+c2dSize nnf_evaluator_evaluated_nodes(NnfEvaluator* evaluator) {
+  c2dSize count = evaluator->evaluated;
+  evaluator->evaluated = 0;
+  return count;
+}
+
+/******************************************************************************
+ * weight updates from file: each line sets the weights of some literals, given as
+ * pairs (literal weight), and the count is printed after each line (lines that
+ * start with c are comments)
+ ******************************************************************************/
+
+void nnf_file_evaluate_updates(const char* nnf_fname, const char* updates_fname, const SatState* sat_state) {
+  FILE* fp = fopen(updates_fname,"r");
+  if(fp==NULL) {
+    fprintf(stderr,"c2D: cannot open weight updates file %s\n",updates_fname);
+    exit(1);
+  }
+  clock_t start_t = clock();
+  NnfEvaluator* evaluator = nnf_evaluator_new(nnf_fname,sat_state);
+  c2dWmc count = nnf_evaluator_count(evaluator);
+  printf("\n  Weights 0\t%0.3"PRIwmcS" (%"PRIvS" nodes, %0.3fs)",count,nnf_evaluator_evaluated_nodes(evaluator),((double)clock()-start_t)/CLOCKS_PER_SEC);
+
+  c2dSize var_count = sat_var_count(sat_state);
+  c2dSize updates   = 0;
+  int ch;
+  while((ch = fgetc(fp))!=EOF) {
+    if(ch=='c') { //comment
+      while(ch!='\n' && ch!=EOF) ch = fgetc(fp);
+      continue;
+    }
+    ungetc(ch,fp);
+
+    //pairs (literal weight) up to the end of line
+    start_t = clock();
+    BOOLEAN empty = 1;
+    while(1) {
+      do ch = fgetc(fp); while(ch==' ' || ch=='\t' || ch=='\r');
+      if(ch=='\n' || ch==EOF) break;
+      ungetc(ch,fp);
+      c2dLiteral literal;
+      c2dWmc weight;
+      if(fscanf(fp,"%ld %lf",&literal,&weight)!=2 || literal==0 || literal>(c2dLiteral)var_count || -literal>(c2dLiteral)var_count || weight<0) {
+        fprintf(stderr,"c2D: bad weight update in %s (expected pairs of literal and non-negative weight)\n",updates_fname);
+        exit(1);
+      }
+      nnf_evaluator_set_weight(literal,weight,evaluator);
+      empty = 0;
+    }
+    if(empty) continue;
+    count = nnf_evaluator_count(evaluator);
+    printf("\n  Weights %"PRIvS"\t%0.3"PRIwmcS" (%"PRIvS" nodes, %0.6fs)",++updates,count,nnf_evaluator_evaluated_nodes(evaluator),((double)clock()-start_t)/CLOCKS_PER_SEC);
+  }
+  fclose(fp);
+  nnf_evaluator_free(evaluator);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
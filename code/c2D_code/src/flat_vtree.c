@@ -0,0 +1,83 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L //posix_memalign
+
+#include "c2d.h"
+
+/******************************************************************************
+ * flattening a vtree:
+ *
+ * --counting and compilation visit vtree nodes millions of times, and each visit
+ *   asks whether the node is a leaf or a Shannon node, and for its variable
+ * --asking the vtree library costs a call per question (the library cannot be
+ *   inlined), and DVtree nodes are wide and scattered over the heap
+ * --before counting or compilation starts, the vtree is therefore copied into an
+ *   array of cache-line sized entries (in DFS order), which holds everything the
+ *   dispatchers need to decide how to handle a vtree node
+ *
+ * the DVtree of each entry is still used for constructing cache keys
+ ******************************************************************************/
+
+//fills entries starting at node, and returns the number of entries filled
+static c2dSize flatten(FVtree* node, DVtree* vtree) {
+  node->vtree     = vtree;
+  node->var_count = vtree->var_count;
+
+  if(vtree_is_leaf(vtree)) {
+    node->var   = vtree->var;
+    node->left  = 0;
+    node->right = 0;
+    node->flags = FV_LEAF;
+    return 1;
+  }
+
+  c2dSize l_count = flatten(node+1,vtree->left);
+  c2dSize r_count = flatten(node+1+l_count,vtree->right);
+  node->left      = 1;
+  node->right     = 1+l_count;
+
+  if(vtree_is_shannon_node(vtree)) {
+    node->var   = vtree_shannon_var(vtree);
+    node->flags = FV_SHANNON;
+    if(vtree->live_cache) node->flags |= FV_CACHE;
+  }
+  else {
+    node->var   = NULL;
+    node->flags = 0;
+  }
+  return 1+l_count+r_count;
+}
+
+//returns the flattened vtree, whose first entry is the root
+FVtree* flatten_vtree(DVtree* vtree) {
+  FVtree* nodes;
+  if(posix_memalign((void**)&nodes,64,(2*vtree->var_count-1)*sizeof(FVtree))) {
+    fprintf(stderr,"c2D: cannot allocate flattened vtree\n");
+    exit(1);
+  }
+  flatten(nodes,vtree);
+  return nodes;
+}
+
+//flags the vtree nodes with projection variables, given projected[i] for each variable index i
+void flag_projected_vtree(FVtree* nodes, const BOOLEAN* projected) {
+  //children follow their parents
+  for(FVtree* node=FV_END(nodes)-1; node>=nodes; node--) {
+    BOOLEAN flag;
+    if(FV_IS_LEAF(node)) flag = projected[sat_var_index(node->var)];
+    else flag = FV_IS_PROJECTED(FV_LEFT(node)) || FV_IS_PROJECTED(FV_RIGHT(node));
+    if(flag) node->flags |= FV_PROJECTED;
+  }
+}
+
+void free_flat_vtree(FVtree* nodes) {
+  free(nodes);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -26,6 +26,30 @@ const char* c2d_version();
 #define COUNT_MODELS 0;
 #define COUNTER      0;
 
+#define TT_VARS      10;
+
+#define CHRONOLOGICAL 0;
+
+#define CACHE_MEMORY 0;
+
+#define COMPRESS_KEYS 0;
+
+#define CUBE_VARS    0;
+#define WORKERS      0;
+#define DETERMINISTIC 0;
+
+#define APPROX       0;
+#define EPSILON      0.8;
+#define DELTA        0.2;
+
+#define PROJECTED    0;
+
+#define THRESHOLD    0;
+
+#define BOUNDS_INTERVAL 0;
+
+#define SEMIRING     's';
+
 /******************************************************************************
  * c2d options 
  ******************************************************************************/
@@ -48,6 +72,23 @@ c2dOptions* init_options() {
   options->count_models       = COUNT_MODELS;
   options->model_counter      = COUNTER;
   options->help               = 0;
+  options->tt_vars            = TT_VARS;
+  options->chronological      = CHRONOLOGICAL;
+  options->spill_filename     = NULL;
+  options->cache_memory       = CACHE_MEMORY;
+  options->compress_keys      = COMPRESS_KEYS;
+  options->cube_vars          = CUBE_VARS;
+  options->workers            = WORKERS;
+  options->deterministic      = DETERMINISTIC;
+  options->approx             = APPROX;
+  options->epsilon            = EPSILON;
+  options->delta              = DELTA;
+  options->projected          = PROJECTED;
+  options->threshold          = THRESHOLD;
+  options->bounds_interval    = BOUNDS_INTERVAL;
+  options->semiring           = SEMIRING;
+  options->sdd_out_filename   = NULL;
+  options->weight_updates_filename = NULL;
   return options;
 }
 
@@ -70,12 +111,29 @@ c2dOptions* get_options(int argc, char** argv) {
       {"check_entail",   no_argument,       0, 'E'},
       {"count_models",   no_argument,       0, 'C'},
       {"model_counter",  no_argument,       0, 'W'},
+      {"tt_vars",        required_argument, 0, 'T'},
+      {"chronological",  required_argument, 0, 'j'},
+      {"spill_file",     required_argument, 0, 'S'},
+      {"cache_memory",   required_argument, 0, 'M'},
+      {"compress_keys",  no_argument,       0, 'K'},
+      {"cube_vars",      required_argument, 0, 'D'},
+      {"workers",        required_argument, 0, 'P'},
+      {"deterministic",  no_argument,       0, 'Z'},
+      {"approx",         no_argument,       0, 'A'},
+      {"epsilon",        required_argument, 0, 'e'},
+      {"delta",          required_argument, 0, 'l'},
+      {"projected",      no_argument,       0, 'p'},
+      {"threshold",      required_argument, 0, 'N'},
+      {"bounds",         required_argument, 0, 'B'},
+      {"semiring",       required_argument, 0, 'r'},
+      {"sdd_out",        required_argument, 0, 'O'},
+      {"weight_updates", required_argument, 0, 'U'},
       {"help",           no_argument,       0, 'h'},
       {0,                0,                 0,  0}
     };
 
     int index = 0;
-    int argument = getopt_long(argc,argv,"c:v:o:d:t:m:b:u:f:s:iECWh",long_options,&index);
+    int argument = getopt_long(argc,argv,"c:v:o:d:t:m:b:u:f:s:iECWT:j:S:M:KD:P:ZAe:l:pN:B:r:O:U:h",long_options,&index);
     if(argument==-1) break;
 
     switch(argument) {
@@ -93,6 +151,23 @@ c2dOptions* get_options(int argc, char** argv) {
       case 'E': options->check_entail       = 1;             break;
       case 'C': options->count_models       = 1;             break;
       case 'W': options->model_counter      = 1;             break;
+      case 'T': options->tt_vars            = atoi(optarg);  break;
+      case 'j': options->chronological      = atoi(optarg);  break;
+      case 'S': options->spill_filename     = optarg;        break;
+      case 'M': options->cache_memory       = atoi(optarg);  break;
+      case 'K': options->compress_keys      = 1;             break;
+      case 'D': options->cube_vars          = atoi(optarg);  break;
+      case 'P': options->workers            = atoi(optarg);  break;
+      case 'Z': options->deterministic      = 1;             break;
+      case 'A': options->approx             = 1;             break;
+      case 'e': options->epsilon            = atof(optarg);  break;
+      case 'l': options->delta              = atof(optarg);  break;
+      case 'p': options->projected          = 1;             break;
+      case 'N': options->threshold          = atof(optarg);  break;
+      case 'B': options->bounds_interval    = atoi(optarg);  break;
+      case 'r': options->semiring           = optarg[0];     break;
+      case 'O': options->sdd_out_filename   = optarg;        break;
+      case 'U': options->weight_updates_filename = optarg;   break;
       case 'h': options->help               = 1;             break;
       default:  print_help(C2D_PACKAGE,1);
     }
@@ -134,6 +209,82 @@ c2dOptions* get_options(int argc, char** argv) {
     fprintf(stderr,"%s: option -s must be greater than 0\n",C2D_PACKAGE);
     print_help(C2D_PACKAGE,1);
   }
+  if(options->tt_vars < 0 || options->tt_vars > TT_MAX_VARS) {
+    fprintf(stderr,"%s: option -T must be between 0 and %d (inclusive)\n",C2D_PACKAGE,TT_MAX_VARS);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->chronological < 0) {
+    fprintf(stderr,"%s: option -j must not be negative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->cache_memory < 0) {
+    fprintf(stderr,"%s: option -M must not be negative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if((options->spill_filename==NULL) != (options->cache_memory==0)) {
+    fprintf(stderr,"%s: options -S and -M must be used together\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->cube_vars < 0 || options->cube_vars > MAX_CUBE_VARS) {
+    fprintf(stderr,"%s: option -D must be between 0 and %d (inclusive)\n",C2D_PACKAGE,MAX_CUBE_VARS);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->workers < 0) {
+    fprintf(stderr,"%s: option -P must not be negative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->workers > 0 && options->cube_vars == 0) {
+    fprintf(stderr,"%s: option -P must be used with option -D\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->approx && (options->model_counter == 0 || options->cube_vars > 0)) {
+    fprintf(stderr,"%s: option -A must be used with option -W (and not with option -D)\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->epsilon <= 0) {
+    fprintf(stderr,"%s: option -e must be positive\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->delta <= 0 || options->delta >= 1) {
+    fprintf(stderr,"%s: option -l must be between 0 and 1 (exclusive)\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->projected && (options->model_counter == 0 || options->cube_vars > 0 || options->approx)) {
+    fprintf(stderr,"%s: option -p must be used with option -W (and not with options -D or -A)\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->threshold < 0) {
+    fprintf(stderr,"%s: option -N must not be negative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->threshold > 0 && (options->model_counter == 0 || options->cube_vars > 0 || options->approx)) {
+    fprintf(stderr,"%s: option -N must be used with option -W (and not with options -D or -A)\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->bounds_interval < 0) {
+    fprintf(stderr,"%s: option -B must not be negative\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->bounds_interval > 0 && (options->model_counter == 0 || options->cube_vars > 0 || options->approx)) {
+    fprintf(stderr,"%s: option -B must be used with option -W (and not with options -D or -A)\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->semiring!='s' && options->semiring!='m' && options->semiring!='l') {
+    fprintf(stderr,"%s: option -r must be 's', 'm' or 'l'\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->semiring!='s' && (options->model_counter == 0 || options->cube_vars > 0 || options->approx || options->projected || options->threshold > 0 || options->bounds_interval > 0)) {
+    fprintf(stderr,"%s: option -r must be used with option -W (and not with options -D, -A, -p, -N or -B)\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->sdd_out_filename!=NULL && options->model_counter) {
+    fprintf(stderr,"%s: option -O cannot be used with option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
+  if(options->weight_updates_filename!=NULL && options->model_counter) {
+    fprintf(stderr,"%s: option -U cannot be used with option -W\n",C2D_PACKAGE);
+    print_help(C2D_PACKAGE,1);
+  }
   return options;
 }
 
@@ -141,7 +292,7 @@ void print_help(const char* PACKAGE, int exit_value) {
   printf("%s: CNF to Decision-DNNF Compiler\n", PACKAGE);
   printf("%s\n",c2d_version());
 
-  printf("%s [-c .] [-v .] [-o .] [-d .] [-t .] [-m .] [-b .] [-u .] [-f .] [-s .]   [-i] [-E] [-C] [-W] [-h]\n", PACKAGE);
+  printf("%s [-c .] [-v .] [-o .] [-d .] [-t .] [-m .] [-b .] [-u .] [-f .] [-s .]   [-i] [-E] [-C] [-W] [-T .] [-j .] [-S .] [-M .] [-K] [-D .] [-P .] [-Z] [-A] [-e .] [-l .] [-p] [-N .] [-B .] [-r .] [-O .] [-U .] [-h]\n", PACKAGE);
    
 
   printf("  --cnf             -c FILE    set input CNF file\n");
@@ -171,6 +322,26 @@ void print_help(const char* PACKAGE, int exit_value) {
   printf("  --check_entail    -E         verify the compiled Decision-DNNF is correct by ensuring it is decomposable and also entails the input CNF\n");
   printf("  --count_models    -C         count the models of the input CNF after compiling it into a Decision-DNNF\n");
   printf("  --model_counter   -W         count the (weighted) models of the input CNF without compiling it into a Decision-DNNF\n");
+  printf("  --tt_vars         -T COUNT   count vtrees with at most COUNT free variables using truth tables when model counting (default 10, 0 disables)\n");
+  printf("  --chronological   -j LEVELS  backtrack one level instead of backjumping over more than LEVELS levels to assert a learned clause (default 0, always backjumps)\n");
+  printf("  --spill_file      -S FILE    spill cache entries to FILE (removed on exit) when their memory exceeds option -M\n");
+  printf("  --cache_memory    -M SIZE    set the memory (in MB) for cache entries when using option -S\n");
+  printf("  --compress_keys   -K         compress the keys of cache entries that were not hit recently (to fit more entries in memory)\n");
+  printf("  --cube_vars       -D COUNT   when model counting, split on the top COUNT Shannon variables of the vtree and count each cube separately (default 0)\n");
+  printf("  --workers         -P COUNT   count the cubes of option -D using COUNT worker processes (default 0, counts them in this process)\n");
+  printf("  --deterministic   -Z         assign cubes of option -P to workers in a fixed order, without reassigning stragglers (for reproducible runs)\n");
+  printf("  --approx          -A         approximate the (unweighted) model count by hashing when using option -W\n");
+  printf("  --epsilon         -e FACTOR  set the tolerance of option -A: the count is within a factor of 1+FACTOR (default 0.8)\n");
+  printf("  --delta           -l PROB    set the confidence of option -A to 1-PROB (default 0.2)\n");
+  printf("  --projected       -p         count models projected onto the variables listed on c ind (or c projection) lines of the CNF when using option -W\n");
+  printf("  --threshold       -N COUNT   stop model counting once the count is known to be at least COUNT (default 0, counts all models)\n");
+  printf("  --bounds          -B SECONDS print lower and upper bounds on the count every SECONDS seconds while model counting, and when terminated by SIGTERM (default 0, none)\n");
+  printf("  --semiring        -r TYPE    set the semiring of option -W\n");
+  printf("                               s: sum-product, the (weighted) model count (default)\n");
+  printf("                               m: max-product, the largest weight of a model, and a model of that weight\n");
+  printf("                               l: log-space, the log of the (weighted) model count\n");
+  printf("  --sdd_out         -O FILE    convert the compiled Decision-DNNF into a Decision-SDD over the same vtree, and save it to FILE (and its vtree to FILE.vtree)\n");
+  printf("  --weight_updates  -U FILE    evaluate the compiled Decision-DNNF incrementally under the weight updates of FILE (each line has pairs of literal and weight)\n");
   printf("  --help            -h         print this help and exit\n");
   exit(exit_value);
 }
@@ -11,9 +11,31 @@ c2dOptions* get_options(int argc, char** argv);
 //compile.c
 NnfManager* compile_vtree(VtreeManager* manager, SatState* sat_state);
 //count.c
-c2dWmc count_vtree(VtreeManager* manager, SatState* sat_state);
+c2dWmc count_vtree(VtreeManager* manager, SatState* sat_state, const c2dOptions* options);
+void set_count_projection(const BOOLEAN* projected);
+BOOLEAN count_threshold_reached();
+void print_mpe_model();
+//approx.c
+c2dWmc approx_count(SatState* sat_state, const c2dOptions* options);
+void print_approx_stats(const c2dOptions* options);
+//truth_table.c
+c2dSize tt_counted_nodes();
+//cubes.c
+void print_cube_stats();
+//projection.c
+BOOLEAN* read_projection(const char* cnf_filename, c2dSize var_count, c2dSize* count);
+VtreeManager* constrain_vtree_manager(VtreeManager* manager, const BOOLEAN* set, const SatState* state, const c2dOptions* options);
+//sdd.c
+void nnf_file_save_as_sdd(const char* nnf_fname, const char* sdd_fname, const VtreeManager* manager, const SatState* sat_state, c2dSize* sdd_count, c2dSize* sdd_size);
+//evaluator.c
+void nnf_file_evaluate_updates(const char* nnf_fname, const char* updates_fname, const SatState* sat_state);
 //cache.c
+void set_vtree_cache_spill(const char* filename, c2dSize memory, VtreeManager* manager);
+void set_vtree_cache_compression(VtreeManager* manager);
 void print_vtree_cache_stats(VtreeCache* vtree_cache);
+//tlb.c
+void tlb_counters_start();
+void print_tlb_misses();
 //utilities.c
 void pprint_bytes(const char* string, c2dSize bytes);
 char* extended_file_name(const char* fname, const char* new_extension);
@@ -27,6 +49,7 @@ int main(int argc, char* argv[]) {
 
   //get options from command line (and defaults)
   c2dOptions* options = get_options(argc,argv);
+  tlb_counters_start();
 
   VtreeManager* manager;
   SatState* sat_state;
@@ -37,6 +60,7 @@ int main(int argc, char* argv[]) {
   start_total_t = start_t = clock();
   printf("\nConstructing CNF...");
   sat_state = sat_state_new(options->cnf_filename);
+  sat_set_chronological_backtracking(options->chronological,sat_state);
   clock_t sat_t = clock()-start_t;
   printf(" DONE");
   printf("\nCNF stats: ");
@@ -55,6 +79,19 @@ int main(int argc, char* argv[]) {
   printf("\n  Vtree Time\t%0.3fs",((double)(vtree_t))/CLOCKS_PER_SEC);
   fflush(stdout);
 
+  BOOLEAN* projected = NULL;
+  if(options->projected) {
+    start_t = clock();
+    c2dSize count;
+    projected = read_projection(options->cnf_filename,sat_var_count(sat_state),&count);
+    printf("\nConstraining vtree by %"PRIvS" projection vars...",count); fflush(stdout);
+    manager = constrain_vtree_manager(manager,projected,sat_state,options);
+    printf(" DONE");
+    printf("\n  "); vtree_print_widths(manager->vtree);
+    printf("\n  Constrain Time\t%0.3fs",((double)clock()-start_t)/CLOCKS_PER_SEC);
+    set_count_projection(projected);
+  }
+
   if(options->vtree_out_filename!=NULL) {
     printf("\nSaving vtree...");
     vtree_save(options->vtree_out_filename,manager->vtree);
@@ -66,20 +103,36 @@ int main(int argc, char* argv[]) {
     printf(" DONE");
   }
 
+  if(options->spill_filename!=NULL)
+    set_vtree_cache_spill(options->spill_filename,options->cache_memory,manager);
+  if(options->compress_keys)
+    set_vtree_cache_compression(manager);
+
   //(weighted) model counting
   if(options->model_counter) {
     start_t = clock();
     printf("\nCounting..."); fflush(stdout);
-    c2dWmc count = count_vtree(manager,sat_state);
+    c2dWmc count = options->approx? approx_count(sat_state,options): count_vtree(manager,sat_state,options);
     clock_t count_t = clock()-start_t;
     printf(" DONE");
     printf("\n  Learned clauses      \t%"PRIvS"",sat_learned_clause_count(sat_state));
     print_vtree_cache_stats(manager->cache);
     printf("\nCount stats:");
     printf("\n  Count Time\t%0.3fs",((double)(count_t))/CLOCKS_PER_SEC);
-    printf("\n  Count \t%0.3"PRIwmcS"",count);
+    printf("\n  Truth tables\t%"PRIvS"",tt_counted_nodes());
+    if(options->cube_vars>0) print_cube_stats();
+    if(options->approx) print_approx_stats(options);
+    if(options->threshold>0 && count_threshold_reached()) printf("\n  Count \tat least %0.3"PRIwmcS" (threshold reached)",count);
+    else if(options->semiring=='m') {
+      printf("\n  MPE \t%0.3"PRIwmcS"",count);
+      print_mpe_model();
+    }
+    else if(options->semiring=='l') printf("\n  Log count \t%0.3"PRIwmcS"",count);
+    else printf("\n  Count \t%0.3"PRIwmcS"",count);
+    print_tlb_misses();
     printf("\nTotal Time: %0.3fs\n\n",((double)clock()-start_total_t)/CLOCKS_PER_SEC);
     free(options);
+    free(projected);
     vtree_manager_free(manager);
     sat_state_free(sat_state);
     return 0;
@@ -112,7 +165,8 @@ int main(int argc, char* argv[]) {
   }
 
   Nnf* nnf = NULL;
-  if(options->count_models || options->check_entail) { //further processing is needed
+  BOOLEAN read_nnf = options->sdd_out_filename!=NULL || options->weight_updates_filename!=NULL; //nnf is read from file
+  if(options->count_models || options->check_entail || read_nnf) { //further processing is needed
     printf("\nPost compilation");
     if(options->in_memory) { //nnf is in memory
       start_t = clock();
@@ -145,6 +199,7 @@ int main(int argc, char* argv[]) {
       printf("\n  Nodes           \t%"PRIvS"",n_count);
       printf("\n  Edges           \t%"PRIvS"",e_count);
     }
+    print_tlb_misses();
     printf("\nTotal Time: %0.3fs\n\n",((double)clock()-start_total_t)/CLOCKS_PER_SEC);
     free(options);
     free(nnf_fname);
@@ -182,6 +237,34 @@ int main(int argc, char* argv[]) {
     printf("%0.3fs",((double)clock()-start_t)/CLOCKS_PER_SEC);
   }
 
+  char* read_fname = nnf_fname;
+  if(read_nnf && options->in_memory) { //the nnf is read from a temporary file
+    read_fname = extended_file_name(options->cnf_filename,".tmp.nnf");
+    nnf_save_to_file(read_fname,nnf);
+  }
+
+  if(options->sdd_out_filename!=NULL) {
+    start_t = clock();
+    printf("\n  Saving Decision-SDD to file..."); fflush(stdout);
+    c2dSize sdd_count, sdd_size;
+    nnf_file_save_as_sdd(read_fname,options->sdd_out_filename,manager,sat_state,&sdd_count,&sdd_size);
+    printf(" DONE");
+    printf("\n  SDD Nodes       \t%"PRIvS"",sdd_count);
+    printf("\n  SDD Size        \t%"PRIvS"",sdd_size);
+    printf("\n  SDD Time        \t%0.3fs",((double)clock()-start_t)/CLOCKS_PER_SEC);
+  }
+
+  if(options->weight_updates_filename!=NULL) {
+    printf("\n  Evaluating weight updates...");
+    nnf_file_evaluate_updates(read_fname,options->weight_updates_filename,sat_state);
+  }
+
+  if(read_fname!=nnf_fname) {
+    remove(read_fname);
+    free(read_fname);
+  }
+
+  print_tlb_misses();
   printf("\nTotal Time: %0.3fs\n\n",((double)clock()-start_total_t)/CLOCKS_PER_SEC);
 
   free(options);
@@ -0,0 +1,329 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//utilities.c
+char* extended_file_name(const char* fname, const char* new_extension);
+
+/******************************************************************************
+ * projected model counting:
+ *
+ * --the models of the cnf are projected onto a set of variables (listed on
+ *   "c ind" or "c projection" lines of the cnf), and the other (auxiliary)
+ *   variables are existentially quantified
+ * --the vtree is constrained so that no auxiliary Shannon variable has a
+ *   projection variable below it: the vtree nodes without projection variables
+ *   then form a frontier, below which counting is replaced by a satisfiability
+ *   check (see count.c)
+ *
+ * an unconstrained Shannon node over auxiliary variable x is fixed by sinking x
+ * below the projection variables of its right child: x passes Shannon nodes, and
+ * goes into the child of a decomposition node whose variables it shares clauses
+ * with. if x shares clauses with both children, the projection variables of the
+ * decomposition node are decided first (as a chain of Shannon nodes), followed by
+ * x and the auxiliary variables of the node (as in the original vtree)
+ *
+ * these moves keep the vtree a decision vtree: no clause mentions variables of
+ * both children of a decomposition node
+ *
+ * before x is sunk, the nodes above the leaves of variables that share clauses
+ * with x are stamped (walking up parent links), so whether x shares clauses with
+ * a child is then a test of its stamp
+ ******************************************************************************/
+
+//a vtree node during constraining
+typedef struct projection_vtree_t {
+  c2dSize var;                            //variable index (leaves only)
+  struct projection_vtree_t* left;
+  struct projection_vtree_t* right;
+  struct projection_vtree_t* parent;      //NULL for the root (and for vtrees being sunk)
+  c2dSize projected;                      //number of projection variables in vtree
+  c2dSize stamp;                          //stamp of the last sunk variable sharing clauses with vtree
+} PVtree;
+
+static const BOOLEAN* projected; //projected[i] is 1 if the variable with index i is a projection variable
+static PVtree** var_leaf;         //var_leaf[i] is the leaf of the variable with index i
+static c2dSize stamp;             //stamp of the variable being sunk
+static const SatState* sat_state;
+static BOOLEAN changed;           //whether the vtree was changed by constraining
+
+/******************************************************************************
+ * reading the projection variables
+ ******************************************************************************/
+
+//returns an array mapping each variable index to 1 if it is a projection variable, 0 otherwise
+//(and sets count to the number of projection variables)
+BOOLEAN* read_projection(const char* cnf_filename, c2dSize var_count, c2dSize* count) {
+  FILE* fp = fopen(cnf_filename,"r");
+  if(fp==NULL) {
+    fprintf(stderr,"c2D: cannot open cnf file %s\n",cnf_filename);
+    exit(1);
+  }
+  BOOLEAN* set = (BOOLEAN*) calloc(var_count+1,sizeof(BOOLEAN));
+  *count = 0;
+
+  int ch;
+  while((ch = fgetc(fp))!=EOF) {
+    char word[16] = "";
+    if(ch=='c' && fscanf(fp,"%*[ \t]%15[a-z]",word)==1 && (strcmp(word,"ind")==0 || strcmp(word,"projection")==0)) {
+      //variable indices, up to the end of line
+      c2dSize index  = 0;
+      BOOLEAN digits = 0;
+      while(1) {
+        ch = fgetc(fp);
+        if(ch>='0' && ch<='9') {
+          index  = 10*index+(ch-'0');
+          digits = 1;
+          continue;
+        }
+        if(digits && index>0) {
+          if(index>var_count) {
+            fprintf(stderr,"c2D: projection variable %"PRIvS" is not a cnf variable\n",index);
+            exit(1);
+          }
+          if(!set[index]) ++*count;
+          set[index] = 1;
+        }
+        index  = 0;
+        digits = 0;
+        if(ch=='\n' || ch==EOF) break;
+      }
+    }
+    while(ch!='\n' && ch!=EOF) ch = fgetc(fp); //rest of line
+  }
+  fclose(fp);
+
+  if(*count==0) {
+    fprintf(stderr,"c2D: no projection variables in %s (expected c ind or c projection lines)\n",cnf_filename);
+    exit(1);
+  }
+  return set;
+}
+
+/******************************************************************************
+ * vtree nodes
+ ******************************************************************************/
+
+static PVtree* new_leaf(c2dSize var) {
+  PVtree* leaf   = (PVtree*) malloc(sizeof(PVtree));
+  leaf->var       = var;
+  leaf->left      = NULL;
+  leaf->right     = NULL;
+  leaf->parent    = NULL;
+  leaf->projected = projected[var];
+  leaf->stamp     = 0;
+  var_leaf[var]   = leaf;
+  return leaf;
+}
+
+static void set_children(PVtree* node, PVtree* left, PVtree* right) {
+  node->left    = left;
+  node->right   = right;
+  left->parent  = node;
+  right->parent = node;
+}
+
+static PVtree* new_internal(PVtree* left, PVtree* right) {
+  PVtree* node   = (PVtree*) malloc(sizeof(PVtree));
+  node->var       = 0;
+  node->parent    = NULL;
+  node->projected = left->projected+right->projected;
+  node->stamp     = 0;
+  set_children(node,left,right);
+  return node;
+}
+
+static PVtree* copy_vtree(const DVtree* vtree) {
+  if(vtree->left==NULL) return new_leaf(sat_var_index(vtree->var));
+  else return new_internal(copy_vtree(vtree->left),copy_vtree(vtree->right));
+}
+
+static void free_vtree(PVtree* vtree) {
+  if(vtree->left!=NULL) {
+    free_vtree(vtree->left);
+    free_vtree(vtree->right);
+  }
+  free(vtree);
+}
+
+//stamp the nodes above the leaves of the variables that share clauses with variable var
+//(a walk stops at a node already stamped, as the nodes above it are stamped too)
+static void stamp_neighbors(c2dSize var) {
+  ++stamp;
+  Var* v = sat_index2var(var,sat_state);
+  for(c2dSize i=0; i<sat_var_occurences(v); i++) {
+    Clause* clause = sat_clause_of_var(i,v);
+    Lit** lits     = sat_clause_literals(clause);
+    for(c2dSize j=0; j<sat_clause_size(clause); j++) {
+      c2dSize index = sat_var_index(sat_literal_var(lits[j]));
+      if(index==var) continue;
+      for(PVtree* node=var_leaf[index]; node!=NULL && node->stamp!=stamp; node=node->parent)
+        node->stamp = stamp;
+    }
+  }
+}
+
+//returns 1 if some clause mentions the variable being sunk and a variable of vtree, 0 otherwise
+static BOOLEAN shares_clauses(const PVtree* vtree) {
+  return vtree->stamp==stamp;
+}
+
+/******************************************************************************
+ * constraining
+ ******************************************************************************/
+
+//appends the leaves of projection variables of vtree to leaves (in inorder), and returns
+//what is left of vtree (NULL if nothing)
+static PVtree* split_projected(PVtree* vtree, PVtree** leaves, c2dSize* count) {
+  if(vtree->left==NULL) {
+    if(!vtree->projected) return vtree;
+    leaves[(*count)++] = vtree;
+    return NULL;
+  }
+  PVtree* left  = split_projected(vtree->left,leaves,count);
+  PVtree* right = split_projected(vtree->right,leaves,count);
+  if(left!=NULL && right!=NULL) {
+    set_children(vtree,left,right);
+    vtree->projected = 0;
+    return vtree;
+  }
+  free(vtree);
+  return left!=NULL? left: right;
+}
+
+//returns a vtree for leaf x (an auxiliary variable) and vtree, in which x is below all
+//projection variables (the neighbors of x are stamped)
+static PVtree* sink_stamped(PVtree* x, PVtree* vtree) {
+  if(vtree->projected==0) return new_internal(x,vtree);
+  changed = 1;
+
+  if(vtree->left==NULL) return new_internal(vtree,x); //a projection variable
+
+  if(vtree->left->left==NULL) { //Shannon node (over a projection variable)
+    set_children(vtree,vtree->left,sink_stamped(x,vtree->right));
+    return vtree;
+  }
+
+  //decomposition node
+  if(!shares_clauses(vtree->left)) {
+    set_children(vtree,vtree->left,sink_stamped(x,vtree->right));
+    return vtree;
+  }
+  if(!shares_clauses(vtree->right)) {
+    set_children(vtree,sink_stamped(x,vtree->left),vtree->right);
+    return vtree;
+  }
+
+  //x is linked to both children: decide the projection variables first
+  PVtree** leaves = (PVtree**) malloc(vtree->projected*sizeof(PVtree*));
+  c2dSize count   = 0;
+  PVtree* rest    = split_projected(vtree,leaves,&count);
+  PVtree* result  = rest!=NULL? new_internal(x,rest): x;
+  while(count>0) result = new_internal(leaves[--count],result);
+  free(leaves);
+  return result;
+}
+
+//returns a vtree for leaf x (an auxiliary variable) and vtree, in which x is below all
+//projection variables (x and vtree have no parent)
+static PVtree* sink(PVtree* x, PVtree* vtree) {
+  x->parent     = NULL;
+  vtree->parent = NULL;
+  if(vtree->projected>0 && vtree->left!=NULL) stamp_neighbors(x->var);
+  return sink_stamped(x,vtree);
+}
+
+//returns vtree after constraining it
+static PVtree* constrain(PVtree* vtree) {
+  if(vtree->left==NULL) return vtree;
+  set_children(vtree,vtree->left,constrain(vtree->right));
+  if(vtree->left->left!=NULL) set_children(vtree,constrain(vtree->left),vtree->right);
+  else if(!vtree->left->projected) { //auxiliary Shannon variable
+    PVtree* x     = vtree->left;
+    PVtree* right = vtree->right;
+    free(vtree);
+    return sink(x,right);
+  }
+  return vtree;
+}
+
+/******************************************************************************
+ * saving the constrained vtree, and constructing its manager
+ ******************************************************************************/
+
+static c2dSize save_nodes(FILE* fp, const PVtree* vtree, c2dSize* id) {
+  if(vtree->left==NULL) {
+    fprintf(fp,"L %"PRIvS" %"PRIvS"\n",*id,vtree->var);
+    return (*id)++;
+  }
+  c2dSize left  = save_nodes(fp,vtree->left,id);
+  c2dSize node  = (*id)++;
+  c2dSize right = save_nodes(fp,vtree->right,id);
+  fprintf(fp,"I %"PRIvS" %"PRIvS" %"PRIvS"\n",node,left,right);
+  return node;
+}
+
+static void save_vtree(const char* fname, const PVtree* vtree, c2dSize var_count) {
+  FILE* fp = fopen(fname,"w");
+  if(fp==NULL) {
+    fprintf(stderr,"c2D: cannot write vtree file %s\n",fname);
+    exit(1);
+  }
+  fprintf(fp,"c vtree constrained by projection (see c2D option -p)\n");
+  fprintf(fp,"vtree %"PRIvS"\n",2*var_count-1);
+  c2dSize id = 0;
+  save_nodes(fp,vtree,&id);
+  fclose(fp);
+}
+
+//returns 1 if no auxiliary Shannon variable of vtree has a projection variable below it
+//(and sets count to the number of projection variables of vtree)
+static BOOLEAN constrained(const DVtree* vtree, c2dSize* count) {
+  if(vtree_is_leaf(vtree)) {
+    *count = projected[sat_var_index(vtree->var)];
+    return 1;
+  }
+  c2dSize left, right;
+  if(!constrained(vtree->left,&left) || !constrained(vtree->right,&right)) return 0;
+  *count = left+right;
+  return !vtree_is_shannon_node(vtree) || left>0 || right==0;
+}
+
+//returns a manager for a vtree constrained by the projection variables (set), which replaces
+//the given manager (freed) if its vtree is not constrained
+VtreeManager* constrain_vtree_manager(VtreeManager* manager, const BOOLEAN* set, const SatState* state, const c2dOptions* options) {
+  projected = set;
+  sat_state = state;
+  changed   = 0;
+  stamp     = 0;
+  var_leaf  = (PVtree**) malloc((sat_var_count(state)+1)*sizeof(PVtree*));
+  PVtree* vtree = constrain(copy_vtree(manager->vtree));
+  free(var_leaf);
+
+  if(changed) {
+    char* fname = extended_file_name(options->cnf_filename,".projected.vtree");
+    save_vtree(fname,vtree,sat_var_count(state));
+    c2dOptions constrained_options = *options;
+    constrained_options.vtree_in_filename = fname;
+    vtree_manager_free(manager);
+    manager = vtree_manager_new(state,&constrained_options);
+    remove(fname);
+    free(fname);
+  }
+  free_vtree(vtree);
+
+  c2dSize count;
+  if(!constrained(manager->vtree,&count)) {
+    fprintf(stderr,"c2D: cannot constrain the vtree by the projection variables\n");
+    exit(1);
+  }
+  return manager;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,487 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+//utilities.c
+char* extended_file_name(const char* fname, const char* new_extension);
+
+/******************************************************************************
+ * converting the compiled Decision-DNNF into a Decision-SDD over the same vtree:
+ *
+ * --the nnf is read in its file format (children before parents), and each nnf
+ *   node is mapped to an SDD node by conjoining (and-nodes) or disjoining (or-nodes)
+ *   the SDD nodes of its children
+ * --the Decision-DNNF respects the vtree: the children of an and-node are over
+ *   disjoint vtrees, and an or-node decides the variable of a Shannon vtree node
+ *   (the left child of which is a leaf). each apply then has at most four elements
+ *   to combine, whose primes are literals or (negated) SDD nodes over disjoint
+ *   vtrees, so the conversion takes linear time
+ * --SDD nodes are unique: a decision node is compressed (its subs are distinct)
+ *   and trimmed, and is looked up by its vtree and elements in a hash table. the
+ *   SDD is then canonical for the vtree
+ *
+ * apply handles any two SDD nodes (it is not limited to Decision-DNNF inputs), and
+ * its results are cached in a table that is overwritten on collisions
+ *
+ * the SDD and its vtree are saved in the file formats of the SDD package, where
+ * vtree nodes are identified by their position in the vtree inorder
+ ******************************************************************************/
+
+#define SDD_FALSE    0
+#define SDD_TRUE     1
+#define SDD_LITERAL  2
+#define SDD_DECISION 3
+
+#define SDD_AND 0
+#define SDD_OR  1
+
+typedef struct sdd_node_t {
+  BYTE type;                       //see above
+  c2dLiteral literal;              //literal nodes only
+  const DVtree* vtree;             //leaf of a literal node, vtree node of a decision node
+  c2dSize index;                   //creation order, after false (0) and true (1)
+  c2dSize size;                    //number of elements (decision nodes only)
+  struct sdd_element_t* elements;  //(prime,sub) pairs, sorted by prime index
+  struct sdd_node_t* negation;     //NULL until the negation is computed
+  struct sdd_node_t* next;         //next node in the same bucket of the unique table
+  c2dSize id;                      //id in the saved file (0 if not saved)
+} SddNode;
+
+typedef struct sdd_element_t {
+  SddNode* prime;
+  SddNode* sub;
+} SddElement;
+
+//an entry of the apply cache
+typedef struct sdd_computed_t {
+  SddNode* node1;
+  SddNode* node2;
+  SddNode* result;
+  BYTE op;
+} SddComputed;
+
+static SddNode sdd_false = { SDD_FALSE, 0, NULL, 0 };
+static SddNode sdd_true  = { SDD_TRUE, 0, NULL, 1 };
+
+static SddNode** literal_nodes; //literal_nodes[var_count+lit]: node of literal lit (NULL until created)
+static c2dSize var_count;
+static const VtreeManager* vtree_manager;
+
+static SddNode** nodes;         //all nodes, in creation order
+static c2dSize node_count;
+static c2dSize node_capacity;
+
+static SddNode** unique_table;  //decision nodes hashed by vtree and elements
+static c2dSize unique_capacity; //a power of 2
+static c2dSize unique_count;
+
+static SddComputed* computed;   //apply cache
+static c2dSize computed_capacity; //a power of 2
+
+/******************************************************************************
+ * vtree nodes: the nodes of a vtree have consecutive inorder positions
+ ******************************************************************************/
+
+#define FIRST_POSITION(v) ((v)->left==NULL? (v)->position: (v)->position-(2*(v)->left->var_count-1))
+#define LAST_POSITION(v)  ((v)->left==NULL? (v)->position: (v)->position+(2*(v)->right->var_count-1))
+
+//returns 1 if vtree node v is in the vtree rooted at w, 0 otherwise
+static inline
+BOOLEAN in_vtree(const DVtree* v, const DVtree* w) {
+  return FIRST_POSITION(w)<=v->position && v->position<=LAST_POSITION(w);
+}
+
+//returns the lowest common ancestor of vtree nodes v and w
+static const DVtree* common_ancestor(const DVtree* v, const DVtree* w) {
+  while(!in_vtree(w,v)) v = v->parent;
+  return v;
+}
+
+/******************************************************************************
+ * unique nodes
+ ******************************************************************************/
+
+static SddNode* new_node(BYTE type, const DVtree* vtree) {
+  if(node_count==node_capacity) {
+    node_capacity *= 2;
+    nodes = (SddNode**) realloc(nodes,node_capacity*sizeof(SddNode*));
+  }
+  SddNode* node  = (SddNode*) calloc(1,sizeof(SddNode));
+  node->type     = type;
+  node->vtree    = vtree;
+  node->index    = node_count+2;
+  nodes[node_count++] = node;
+  return node;
+}
+
+static SddNode* literal_node(c2dLiteral literal) {
+  SddNode** node = literal_nodes+var_count+literal;
+  if(*node==NULL) {
+    *node = new_node(SDD_LITERAL,vtree_manager->var_map[literal>0? literal: -literal]);
+    (*node)->literal = literal;
+  }
+  return *node;
+}
+
+static HASHCODE hash_elements(const DVtree* vtree, const SddElement* elements, c2dSize size) {
+  HASHCODE hashcode = vtree->position;
+  for(c2dSize i=0; i<size; i++) {
+    hashcode = hashcode*31+elements[i].prime->index;
+    hashcode = hashcode*31+elements[i].sub->index;
+  }
+  return hashcode^(hashcode>>29);
+}
+
+static void grow_unique_table() {
+  c2dSize capacity = 2*unique_capacity;
+  SddNode** table  = (SddNode**) sat_huge_alloc(capacity*sizeof(SddNode*));
+  for(c2dSize i=0; i<unique_capacity; i++) {
+    SddNode* node = unique_table[i];
+    while(node!=NULL) {
+      SddNode* next = node->next;
+      HASHCODE slot = hash_elements(node->vtree,node->elements,node->size)&(capacity-1);
+      node->next    = table[slot];
+      table[slot]   = node;
+      node          = next;
+    }
+  }
+  sat_huge_free(unique_table,unique_capacity*sizeof(SddNode*));
+  unique_table    = table;
+  unique_capacity = capacity;
+}
+
+static int compare_subs(const void* e1, const void* e2) {
+  c2dSize i1 = ((const SddElement*)e1)->sub->index;
+  c2dSize i2 = ((const SddElement*)e2)->sub->index;
+  return (i1>i2)-(i1<i2);
+}
+
+static int compare_primes(const void* e1, const void* e2) {
+  c2dSize i1 = ((const SddElement*)e1)->prime->index;
+  c2dSize i2 = ((const SddElement*)e2)->prime->index;
+  return (i1>i2)-(i1<i2);
+}
+
+static SddNode* apply(SddNode* node1, SddNode* node2, BYTE op);
+
+//returns the unique node for elements (primes are consistent, and partition true) over
+//vtree node, after compressing and trimming them (elements is overwritten)
+static SddNode* decision_node(const DVtree* vtree, SddElement* elements, c2dSize size) {
+  //compress: disjoin the primes of equal subs
+  qsort(elements,size,sizeof(SddElement),compare_subs);
+  c2dSize count = 0;
+  for(c2dSize i=0; i<size; i++) {
+    if(count>0 && elements[count-1].sub==elements[i].sub)
+      elements[count-1].prime = apply(elements[count-1].prime,elements[i].prime,SDD_OR);
+    else elements[count++] = elements[i];
+  }
+
+  //trim: {(true,s)} is s, and {(p,true),(~p,false)} is p
+  if(count==1) return elements[0].sub;
+  if(count==2) {
+    if(elements[0].sub==&sdd_true && elements[1].sub==&sdd_false) return elements[0].prime;
+    if(elements[1].sub==&sdd_true && elements[0].sub==&sdd_false) return elements[1].prime;
+  }
+
+  qsort(elements,count,sizeof(SddElement),compare_primes);
+  HASHCODE slot = hash_elements(vtree,elements,count)&(unique_capacity-1);
+  for(SddNode* node=unique_table[slot]; node!=NULL; node=node->next) {
+    if(node->vtree!=vtree || node->size!=count) continue;
+    c2dSize i = 0;
+    while(i<count && node->elements[i].prime==elements[i].prime && node->elements[i].sub==elements[i].sub) i++;
+    if(i==count) return node;
+  }
+
+  SddNode* node  = new_node(SDD_DECISION,vtree);
+  node->size     = count;
+  node->elements = (SddElement*) malloc(count*sizeof(SddElement));
+  memcpy(node->elements,elements,count*sizeof(SddElement));
+  node->next     = unique_table[slot];
+  unique_table[slot] = node;
+  if(++unique_count>unique_capacity) grow_unique_table();
+  return node;
+}
+
+/******************************************************************************
+ * negation and apply
+ ******************************************************************************/
+
+static SddNode* negate(SddNode* node) {
+  if(node->negation!=NULL) return node->negation;
+  SddNode* negation;
+  if(node->type==SDD_FALSE)        negation = &sdd_true;
+  else if(node->type==SDD_TRUE)    negation = &sdd_false;
+  else if(node->type==SDD_LITERAL) negation = literal_node(-node->literal);
+  else {
+    SddElement* elements = (SddElement*) malloc(node->size*sizeof(SddElement));
+    for(c2dSize i=0; i<node->size; i++) {
+      elements[i].prime = node->elements[i].prime;
+      elements[i].sub   = negate(node->elements[i].sub);
+    }
+    negation = decision_node(node->vtree,elements,node->size);
+    free(elements);
+  }
+  node->negation     = negation;
+  negation->negation = node;
+  return negation;
+}
+
+//sets elements to the elements of node as a decision node over vtree (an ancestor of
+//its vtree, or its vtree), and returns their number
+static c2dSize expand(SddNode* node, const DVtree* vtree, SddElement* elements) {
+  if(node->vtree==vtree) {
+    memcpy(elements,node->elements,node->size*sizeof(SddElement));
+    return node->size;
+  }
+  if(in_vtree(node->vtree,vtree->left)) {
+    elements[0].prime = node;
+    elements[0].sub   = &sdd_true;
+    elements[1].prime = negate(node);
+    elements[1].sub   = &sdd_false;
+    return 2;
+  }
+  elements[0].prime = &sdd_true;
+  elements[0].sub   = node;
+  return 1;
+}
+
+static SddNode* apply(SddNode* node1, SddNode* node2, BYTE op) {
+  //terminal cases
+  if(node1==node2) return node1;
+  if(node1->type<=SDD_TRUE || node2->type<=SDD_TRUE) {
+    if(node1->type>SDD_TRUE) { SddNode* node = node1; node1 = node2; node2 = node; }
+    //node1 is false or true
+    if(op==SDD_AND) return node1->type==SDD_TRUE? node2: &sdd_false;
+    else return node1->type==SDD_TRUE? &sdd_true: node2;
+  }
+  if(node1->negation==node2 || (node1->type==SDD_LITERAL && node1->vtree==node2->vtree)) //complementary
+    return op==SDD_AND? &sdd_false: &sdd_true;
+
+  if(node1->index>node2->index) { SddNode* node = node1; node1 = node2; node2 = node; }
+  HASHCODE slot = ((node1->index*0x9E3779B97F4A7C15UL)^(node2->index*0xC2B2AE3D27D4EB4FUL)^op)>>32&(computed_capacity-1);
+  SddComputed* entry = computed+slot;
+  if(entry->node1==node1 && entry->node2==node2 && entry->op==op) return entry->result;
+
+  const DVtree* vtree = common_ancestor(node1->vtree,node2->vtree);
+  SddElement* elements1 = (SddElement*) malloc((node1->size+2)*sizeof(SddElement));
+  SddElement* elements2 = (SddElement*) malloc((node2->size+2)*sizeof(SddElement));
+  c2dSize size1 = expand(node1,vtree,elements1);
+  c2dSize size2 = expand(node2,vtree,elements2);
+
+  SddElement* elements = (SddElement*) malloc(size1*size2*sizeof(SddElement));
+  c2dSize size = 0;
+  for(c2dSize i=0; i<size1; i++) {
+    for(c2dSize j=0; j<size2; j++) {
+      SddNode* prime = apply(elements1[i].prime,elements2[j].prime,SDD_AND);
+      if(prime==&sdd_false) continue;
+      elements[size].prime = prime;
+      elements[size].sub   = apply(elements1[i].sub,elements2[j].sub,op);
+      ++size;
+    }
+  }
+  SddNode* result = decision_node(vtree,elements,size);
+  free(elements);
+  free(elements1);
+  free(elements2);
+
+  entry->node1  = node1;
+  entry->node2  = node2;
+  entry->op     = op;
+  entry->result = result;
+  return result;
+}
+
+/******************************************************************************
+ * reading the nnf
+ ******************************************************************************/
+
+static void bad_nnf_file(const char* fname) {
+  fprintf(stderr,"c2D: cannot read nnf file %s\n",fname);
+  exit(1);
+}
+
+//returns the SDD of the nnf saved in file fname
+static SddNode* read_nnf(const char* fname) {
+  FILE* fp = fopen(fname,"r");
+  if(fp==NULL) bad_nnf_file(fname);
+
+  c2dSize nnf_count, edge_count, nnf_vars;
+  char type;
+  //skip comments
+  while(fscanf(fp," %c",&type)==1 && type=='c') {
+    int ch;
+    while((ch = fgetc(fp))!='\n' && ch!=EOF);
+  }
+  if(type!='n' || fscanf(fp,"nf %"PRIvS" %"PRIvS" %"PRIvS"",&nnf_count,&edge_count,&nnf_vars)!=3 || nnf_count==0)
+    bad_nnf_file(fname);
+
+  //an apply cache entry for each edge (up to 2^24 entries)
+  for(computed_capacity=1024; computed_capacity<edge_count && computed_capacity<(1UL<<24); computed_capacity *= 2);
+  computed = (SddComputed*) sat_huge_alloc(computed_capacity*sizeof(SddComputed));
+
+  SddNode** sdds = (SddNode**) malloc(nnf_count*sizeof(SddNode*));
+  for(c2dSize i=0; i<nnf_count; i++) {
+    c2dLiteral literal;
+    c2dSize decision, size, child;
+    if(fscanf(fp," %c",&type)!=1) bad_nnf_file(fname);
+    if(type=='L') {
+      if(fscanf(fp,"%ld",&literal)!=1 || literal==0 || literal>(c2dLiteral)var_count || -literal>(c2dLiteral)var_count)
+        bad_nnf_file(fname);
+      sdds[i] = literal_node(literal);
+    }
+    else if(type=='A' || type=='O') {
+      if(type=='O' && fscanf(fp,"%"PRIvS"",&decision)!=1) bad_nnf_file(fname);
+      if(fscanf(fp,"%"PRIvS"",&size)!=1) bad_nnf_file(fname);
+      BYTE op = type=='A'? SDD_AND: SDD_OR;
+      SddNode* node = op==SDD_AND? &sdd_true: &sdd_false;
+      for(c2dSize j=0; j<size; j++) {
+        if(fscanf(fp,"%"PRIvS"",&child)!=1 || child>=i) bad_nnf_file(fname);
+        node = apply(node,sdds[child],op);
+      }
+      sdds[i] = node;
+    }
+    else bad_nnf_file(fname);
+  }
+  fclose(fp);
+
+  SddNode* root = sdds[nnf_count-1];
+  free(sdds);
+  return root;
+}
+
+/******************************************************************************
+ * saving the SDD and its vtree
+ ******************************************************************************/
+
+//sets the ids of the nodes of the SDD rooted at node (1 plus their position in the file)
+static void mark_sdd(SddNode* node) {
+  if(node->id) return;
+  node->id = 1;
+  for(c2dSize i=0; i<node->size; i++) {
+    mark_sdd(node->elements[i].prime);
+    mark_sdd(node->elements[i].sub);
+  }
+}
+
+static void save_sdd(const char* fname, SddNode* root, c2dSize* sdd_count, c2dSize* sdd_size) {
+  FILE* fp = fopen(fname,"w");
+  if(fp==NULL) {
+    fprintf(stderr,"c2D: cannot write sdd file %s\n",fname);
+    exit(1);
+  }
+  sdd_false.id = sdd_true.id = 0;
+  for(c2dSize i=0; i<node_count; i++) nodes[i]->id = 0;
+  mark_sdd(root);
+
+  //false and true first, then the other nodes in creation order (children before parents)
+  c2dSize count = 0;
+  *sdd_size     = 0;
+  if(sdd_false.id) sdd_false.id = ++count;
+  if(sdd_true.id)  sdd_true.id  = ++count;
+  for(c2dSize i=0; i<node_count; i++)
+    if(nodes[i]->id) {
+      nodes[i]->id = ++count;
+      *sdd_size += nodes[i]->size;
+    }
+  *sdd_count = count;
+
+  fprintf(fp,"c ids of sdd nodes start at 0\n");
+  fprintf(fp,"c sdd nodes appear bottom-up, children before parents\n");
+  fprintf(fp,"c\n");
+  fprintf(fp,"c file syntax:\n");
+  fprintf(fp,"c sdd count-of-sdd-nodes\n");
+  fprintf(fp,"c F id-of-false-sdd-node\n");
+  fprintf(fp,"c T id-of-true-sdd-node\n");
+  fprintf(fp,"c L id-of-literal-sdd-node id-of-vtree literal\n");
+  fprintf(fp,"c D id-of-decomposition-sdd-node id-of-vtree number-of-elements {id-of-prime id-of-sub}*\n");
+  fprintf(fp,"c\n");
+  fprintf(fp,"sdd %"PRIvS"\n",count);
+  if(sdd_false.id) fprintf(fp,"F %"PRIvS"\n",sdd_false.id-1);
+  if(sdd_true.id)  fprintf(fp,"T %"PRIvS"\n",sdd_true.id-1);
+  for(c2dSize i=0; i<node_count; i++) {
+    SddNode* node = nodes[i];
+    if(!node->id) continue;
+    if(node->type==SDD_LITERAL) fprintf(fp,"L %"PRIvS" %"PRIvS" %ld\n",node->id-1,node->vtree->position,node->literal);
+    else {
+      fprintf(fp,"D %"PRIvS" %"PRIvS" %"PRIvS"",node->id-1,node->vtree->position,node->size);
+      for(c2dSize j=0; j<node->size; j++)
+        fprintf(fp," %"PRIvS" %"PRIvS"",node->elements[j].prime->id-1,node->elements[j].sub->id-1);
+      fprintf(fp,"\n");
+    }
+  }
+  fclose(fp);
+}
+
+static void save_vtree_nodes(FILE* fp, const DVtree* vtree) {
+  if(vtree->left==NULL) fprintf(fp,"L %"PRIvS" %"PRIvS"\n",vtree->position,sat_var_index(vtree->var));
+  else {
+    save_vtree_nodes(fp,vtree->left);
+    save_vtree_nodes(fp,vtree->right);
+    fprintf(fp,"I %"PRIvS" %"PRIvS" %"PRIvS"\n",vtree->position,vtree->left->position,vtree->right->position);
+  }
+}
+
+static void save_sdd_vtree(const char* fname, const DVtree* vtree) {
+  FILE* fp = fopen(fname,"w");
+  if(fp==NULL) {
+    fprintf(stderr,"c2D: cannot write vtree file %s\n",fname);
+    exit(1);
+  }
+  fprintf(fp,"c ids of vtree nodes start at 0\n");
+  fprintf(fp,"c ids of variables start at 1\n");
+  fprintf(fp,"c vtree nodes appear bottom-up, children before parents\n");
+  fprintf(fp,"c\n");
+  fprintf(fp,"c file syntax:\n");
+  fprintf(fp,"c vtree number-of-nodes-in-vtree\n");
+  fprintf(fp,"c L id-of-leaf-vtree-node id-of-variable\n");
+  fprintf(fp,"c I id-of-internal-vtree-node id-of-left-child id-of-right-child\n");
+  fprintf(fp,"c\n");
+  fprintf(fp,"vtree %"PRIvS"\n",2*vtree->var_count-1);
+  save_vtree_nodes(fp,vtree);
+  fclose(fp);
+}
+
+/******************************************************************************
+ * main conversion code
+ ******************************************************************************/
+
+//converts the nnf saved in file nnf_fname (compiled using the vtree of manager) into an
+//SDD, and saves it to file sdd_fname (and the vtree to sdd_fname.vtree)
+//
+//sets sdd_count and sdd_size to the node and element counts of the SDD
+void nnf_file_save_as_sdd(const char* nnf_fname, const char* sdd_fname, const VtreeManager* manager, const SatState* sat_state, c2dSize* sdd_count, c2dSize* sdd_size) {
+  vtree_manager = manager;
+  var_count     = sat_var_count(sat_state);
+  literal_nodes = (SddNode**) calloc(2*var_count+1,sizeof(SddNode*));
+  node_count    = 0;
+  node_capacity = 1024;
+  nodes         = (SddNode**) malloc(node_capacity*sizeof(SddNode*));
+  unique_count  = 0;
+  unique_capacity   = 1024;
+  unique_table      = (SddNode**) sat_huge_alloc(unique_capacity*sizeof(SddNode*));
+  sdd_false.negation = &sdd_true;
+  sdd_true.negation  = &sdd_false;
+
+  SddNode* root = read_nnf(nnf_fname);
+  save_sdd(sdd_fname,root,sdd_count,sdd_size);
+  char* vtree_fname = extended_file_name(sdd_fname,".vtree");
+  save_sdd_vtree(vtree_fname,manager->vtree);
+  free(vtree_fname);
+
+  for(c2dSize i=0; i<node_count; i++) {
+    free(nodes[i]->elements);
+    free(nodes[i]);
+  }
+  free(nodes);
+  free(literal_nodes);
+  sat_huge_free(unique_table,unique_capacity*sizeof(SddNode*));
+  sat_huge_free(computed,computed_capacity*sizeof(SddComputed));
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,285 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L //getpid
+#include <unistd.h>
+#include "c2d.h"
+
+//utilities.c
+void pprint_bytes(const char* string, c2dSize bytes);
+
+/******************************************************************************
+ * spilling cache entries to a file:
+ *
+ * --when the memory of cache entries exceeds its limit, cold entries are moved
+ *   from the cache to the end of an append-only spill file
+ * --a spilled entry is found using an in memory index, which maps the fingerprint
+ *   of the entry (its vtree node and key) to its offset in the spill file
+ * --a bloom filter of the fingerprints is checked before the index, and the key
+ *   of a spilled entry is compared after reading it, so the file is only read
+ *   for entries that were (most likely) spilled
+ * --a spilled entry that is found is removed from the index, and is then inserted
+ *   back into the cache
+ *
+ * when the cache entries of a vtree node are dropped, the generation of the vtree
+ * node is incremented. since fingerprints include generations, the spilled entries
+ * of the vtree node can no longer be found (their space in file is not reused).
+ * their slots in index are stale: they count towards the load of index, and are
+ * left out when index (and the bloom filter) is rebuilt
+ ******************************************************************************/
+
+//a spilled entry in the spill file (followed by its key)
+typedef struct {
+  unsigned int position;   //position of the vtree node of entry
+  unsigned int generation; //generation of the vtree node when entry was spilled
+  VtreeCV value;
+} SpillRecord;
+
+//initial number of slots in index
+#define SPILL_INDEX_SLOTS (1UL<<16)
+
+//index is rebuilt when more than half of its slots are not free
+#define SPILL_INDEX_MAX_LOAD(capacity) ((capacity)/2)
+
+//bits of bloom filter for each slot of index
+#define BLOOM_BITS_PER_SLOT 8
+
+/******************************************************************************
+ * fingerprints and bloom filter
+ ******************************************************************************/
+
+static unsigned long fingerprint(c2dSize position, unsigned int generation, const BYTE* key, c2dSize size) {
+  unsigned long h = 14695981039346656037UL; //FNV-1a
+  h = (h^position)*1099511628211UL;
+  h = (h^generation)*1099511628211UL;
+  while(size--) h = (h^*key++)*1099511628211UL;
+  return h<2? h+2: h; //0 and 1 mark empty and deleted slots
+}
+
+//the i^th bit of fingerprint in bloom filter
+#define BLOOM_BIT(fp,i,bits) (((fp)+(i)*(((fp)>>32)|1))%(bits))
+
+static void bloom_add(unsigned long fp, VtreeSpill* spill) {
+  for(c2dSize i=0; i<2; i++) {
+    c2dSize bit = BLOOM_BIT(fp,i,spill->bloom_bits);
+    spill->bloom[bit/8] |= (BYTE)(1<<(bit%8));
+  }
+}
+
+static BOOLEAN bloom_test(unsigned long fp, const VtreeSpill* spill) {
+  for(c2dSize i=0; i<2; i++) {
+    c2dSize bit = BLOOM_BIT(fp,i,spill->bloom_bits);
+    if((spill->bloom[bit/8]&(1<<(bit%8)))==0) return 0;
+  }
+  return 1;
+}
+
+/******************************************************************************
+ * constructing and freeing
+ ******************************************************************************/
+
+static void allocate_index(c2dSize capacity, VtreeSpill* spill) {
+  spill->index      = (VtreeSI*) calloc(capacity,sizeof(VtreeSI));
+  spill->capacity   = capacity;
+  spill->deleted    = 0;
+  spill->bloom_bits = BLOOM_BITS_PER_SLOT*capacity;
+  spill->bloom      = (BYTE*) calloc(spill->bloom_bits/8,sizeof(BYTE));
+}
+
+VtreeSpill* construct_vtree_spill(const char* filename, c2dSize vtree_count, c2dSize key_size) {
+  VtreeSpill* spill = (VtreeSpill*) malloc(sizeof(VtreeSpill));
+  spill->filename = (char*) malloc((strlen(filename)+1)*sizeof(char));
+  strcpy(spill->filename,filename);
+  spill->file     = fopen(filename,"w+b");
+  if(spill->file==NULL) {
+    fprintf(stderr,"c2D: cannot open spill file %s\n",filename);
+    exit(1);
+  }
+  spill->size        = 0;
+  spill->count       = 0;
+  spill->stale       = 0;
+  spill->vtree_count = vtree_count;
+  spill->generations = (unsigned int*) calloc(vtree_count,sizeof(unsigned int));
+  spill->counts      = (c2dSize*) calloc(vtree_count,sizeof(c2dSize));
+  spill->key         = (BYTE*) malloc((key_size+1)*sizeof(BYTE));
+  spill->spills      = 0;
+  spill->hits        = 0;
+  spill->reads       = 0;
+  spill->filtered    = 0;
+  allocate_index(SPILL_INDEX_SLOTS,spill);
+  return spill;
+}
+
+//the spill file is removed
+void free_vtree_spill(VtreeSpill* spill) {
+  fclose(spill->file);
+  remove(spill->filename);
+  free(spill->filename);
+  free(spill->index);
+  free(spill->bloom);
+  free(spill->generations);
+  free(spill->counts);
+  free(spill->key);
+  free(spill);
+}
+
+//a forked worker spills to a file of its own (the spill file suffixed with its pid), as
+//the inherited file shares its offset with the coordinator and the other workers
+//entries spilled before the fork are forgotten (the inherited file is left untouched)
+//the new file is removed once opened, so it goes away when the worker exits
+void fork_vtree_spill(VtreeSpill* spill) {
+  char* filename = (char*) malloc((strlen(spill->filename)+24)*sizeof(char));
+  sprintf(filename,"%s.%ld",spill->filename,(long)getpid());
+  spill->file = fopen(filename,"w+b");
+  if(spill->file==NULL) {
+    fprintf(stderr,"c2D: cannot open spill file %s\n",filename);
+    exit(1);
+  }
+  remove(filename);
+  free(spill->filename);
+  spill->filename = filename;
+  spill->size     = 0;
+  free(spill->index);
+  free(spill->bloom);
+  allocate_index(SPILL_INDEX_SLOTS,spill);
+  spill->count    = 0;
+  spill->stale    = 0;
+  memset(spill->counts,0,spill->vtree_count*sizeof(c2dSize));
+}
+
+/******************************************************************************
+ * index
+ ******************************************************************************/
+
+static void index_insert(const VtreeSI* entry, VtreeSpill* spill) {
+  c2dSize slot = entry->fingerprint % spill->capacity;
+  while(spill->index[slot].fingerprint>1)
+    if(++slot==spill->capacity) slot = 0;
+  if(spill->index[slot].fingerprint==1) --spill->deleted;
+  spill->index[slot] = *entry;
+  ++spill->count;
+  ++spill->counts[entry->position];
+  bloom_add(entry->fingerprint,spill);
+}
+
+//move the entries of index of current generations into a new index (without deleted
+//or stale slots), and rebuild the bloom filter
+static void rebuild_index(VtreeSpill* spill) {
+  VtreeSI* index   = spill->index;
+  c2dSize capacity = spill->capacity;
+  c2dSize count    = spill->count;
+
+  free(spill->bloom);
+  allocate_index(4*(count+1)>capacity? 2*capacity: capacity,spill);
+  spill->count = 0;
+  spill->stale = 0;
+  memset(spill->counts,0,spill->vtree_count*sizeof(c2dSize));
+  for(c2dSize i=0; i<capacity; i++)
+    if(index[i].fingerprint>1 && index[i].generation==spill->generations[index[i].position])
+      index_insert(index+i,spill);
+  free(index);
+}
+
+/******************************************************************************
+ * spilling and finding entries
+ ******************************************************************************/
+
+//append an entry (vtree node, key and value) to the spill file
+void spill_entry(const DVtree* vtree, const BYTE* key, VtreeCV value, VtreeSpill* spill) {
+  SpillRecord record;
+  record.position   = vtree->position;
+  record.generation = spill->generations[vtree->position];
+  record.value      = value;
+
+  fseek(spill->file,spill->size,SEEK_SET);
+  if(fwrite(&record,sizeof(SpillRecord),1,spill->file)!=1 ||
+     fwrite(key,sizeof(BYTE),vtree->key_size,spill->file)!=vtree->key_size) {
+    fprintf(stderr,"c2D: cannot write spill file %s\n",spill->filename);
+    exit(1);
+  }
+
+  if(spill->count+spill->deleted+spill->stale>=SPILL_INDEX_MAX_LOAD(spill->capacity)) rebuild_index(spill);
+  VtreeSI entry;
+  entry.fingerprint = fingerprint(record.position,record.generation,key,vtree->key_size);
+  entry.offset      = spill->size;
+  entry.position    = record.position;
+  entry.generation  = record.generation;
+  index_insert(&entry,spill);
+
+  spill->size += sizeof(SpillRecord)+vtree->key_size;
+  ++spill->spills;
+}
+
+//return 1 if the read record is the entry of vtree node with its current key, 0 otherwise
+static BOOLEAN read_entry(SpillRecord* record, BYTE* key, c2dSize offset, const DVtree* vtree, VtreeSpill* spill) {
+  ++spill->reads;
+  fseek(spill->file,offset,SEEK_SET);
+  if(fread(record,sizeof(SpillRecord),1,spill->file)!=1 ||
+     fread(key,sizeof(BYTE),vtree->key_size,spill->file)!=vtree->key_size) {
+    fprintf(stderr,"c2D: cannot read spill file %s\n",spill->filename);
+    exit(1);
+  }
+  return record->position==vtree->position &&
+         record->generation==spill->generations[vtree->position] &&
+         memcmp(key,vtree->key,vtree->key_size)==0;
+}
+
+//return 1 if the current key of vtree node was spilled, 0 otherwise
+//if successful, set the value of result accordingly (the entry is no longer spilled)
+//assume that the key and hashcode of vtree node are current
+BOOLEAN lookup_spill(VtreeCV* result, const DVtree* vtree, VtreeSpill* spill) {
+  if(spill->count==0) return 0;
+  c2dSize p        = vtree->position;
+  unsigned long fp = fingerprint(p,spill->generations[p],vtree->key,vtree->key_size);
+  if(!bloom_test(fp,spill)) {
+    ++spill->filtered;
+    return 0;
+  }
+
+  BOOLEAN found = 0;
+  SpillRecord record;
+  c2dSize slot = fp % spill->capacity;
+  while(spill->index[slot].fingerprint!=0) {
+    VtreeSI* entry = spill->index+slot;
+    if(entry->fingerprint==fp && read_entry(&record,spill->key,entry->offset,vtree,spill)) {
+      //remove from index
+      entry->fingerprint = 1;
+      --spill->count;
+      --spill->counts[p];
+      ++spill->deleted;
+      ++spill->hits;
+      *result = record.value;
+      found   = 1;
+      break;
+    }
+    if(++slot==spill->capacity) slot = 0;
+  }
+  return found;
+}
+
+//spilled entries of vtree node can no longer be found (their slots in index are stale)
+void drop_spilled_entries(const DVtree* vtree, VtreeSpill* spill) {
+  c2dSize p = vtree->position;
+  ++spill->generations[p];
+  spill->count    -= spill->counts[p];
+  spill->stale    += spill->counts[p];
+  spill->counts[p] = 0;
+}
+
+/******************************************************************************
+ * stats
+ ******************************************************************************/
+
+void print_vtree_spill_stats(const VtreeSpill* spill) {
+  printf(     "\n  spilled    \t%"PRIvS" entries, %"PRIvS" found",spill->spills,spill->hits);
+  printf(     "\n  spill reads\t%"PRIvS" (%"PRIvS" filtered)",spill->reads,spill->filtered);
+  pprint_bytes("\n  spill file \t",spill->size);
+  pprint_bytes("\n  spill index\t",spill->capacity*sizeof(VtreeSI)+spill->bloom_bits/8);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -0,0 +1,75 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#define _DEFAULT_SOURCE //syscall
+#include <unistd.h>
+#include <stdint.h>
+#include "c2d.h"
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/******************************************************************************
+ * TLB misses: counted by the hardware performance counters of the processor
+ * (perf_event_open on Linux), to see whether the huge page regions of the cache,
+ * clauses and nnf nodes pay off (see huge.c of the sat library)
+ *
+ * --data TLB misses of loads and of stores are counted separately, in user mode
+ *   only (which is allowed at the default perf_event_paranoid level)
+ * --a counter that cannot be opened (other systems, virtual machines without a
+ *   PMU, a stricter paranoid level) is not reported
+ ******************************************************************************/
+
+#define TLB_LOADS  0
+#define TLB_STORES 1
+
+static int counters[2] = {-1,-1}; //file descriptors of counters (-1 if not available)
+
+#ifdef __linux__
+static int open_counter(unsigned long long op) {
+  struct perf_event_attr attr;
+  memset(&attr,0,sizeof(attr));
+  attr.type           = PERF_TYPE_HW_CACHE;
+  attr.size           = sizeof(attr);
+  attr.config         = PERF_COUNT_HW_CACHE_DTLB|(op<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  return (int) syscall(__NR_perf_event_open,&attr,0,-1,-1,0); //this process, any cpu
+}
+#endif
+
+//starts counting the TLB misses of c2D
+void tlb_counters_start() {
+#ifdef __linux__
+  counters[TLB_LOADS]  = open_counter(PERF_COUNT_HW_CACHE_OP_READ);
+  counters[TLB_STORES] = open_counter(PERF_COUNT_HW_CACHE_OP_WRITE);
+#endif
+}
+
+//returns 1 and sets misses if the counter is available, 0 otherwise
+static BOOLEAN read_counter(int counter, c2dSize* misses) {
+  uint64_t value;
+  if(counters[counter]<0 || read(counters[counter],&value,sizeof(value))!=sizeof(value)) return 0;
+  *misses = (c2dSize) value;
+  return 1;
+}
+
+//prints the TLB misses counted so far (nothing if no counter is available)
+void print_tlb_misses() {
+  c2dSize loads, stores;
+  BOOLEAN has_loads  = read_counter(TLB_LOADS,&loads);
+  BOOLEAN has_stores = read_counter(TLB_STORES,&stores);
+  if(!has_loads && !has_stores) return;
+  printf("\nTLB misses:");
+  if(has_loads)  printf(" %"PRIvS" loads",loads);
+  if(has_loads && has_stores) printf(" /");
+  if(has_stores) printf(" %"PRIvS" stores",stores);
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
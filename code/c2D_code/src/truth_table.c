@@ -0,0 +1,181 @@
+/******************************************************************************
+ * The c2D Compiler Package
+ * c2D version 1.00, May 24, 2015
+ * http://reasoning.cs.ucla.edu/c2d
+ ******************************************************************************/
+
+#include "c2d.h"
+
+/******************************************************************************
+ * truth-table counting of small vtrees:
+ *
+ * --near the leaves, a vtree node usually has only a handful of free variables
+ * --for such a node, deciding variables one at a time (and building cache keys)
+ *   costs far more than simply enumerating all assignments of its free variables
+ * --the live clauses of the node are evaluated over a bit-parallel truth table
+ *   (one bit per assignment, 64 assignments per word) and the satisfying
+ *   assignments are then counted using popcount
+ *
+ * the leaves of a vtree node are found among the entries its flattened vtree
+ * spans
+ *
+ * the truth table is only used when all free variables have unit weights, and
+ * when every live clause of the node mentions only variables inside the node
+ * (otherwise the regular counting cases are used)
+ ******************************************************************************/
+
+#define TT_MAX_WORDS (1UL<<(TT_MAX_VARS-6))
+
+typedef unsigned long TTWORD; //64 bits
+
+//truth tables of the first six variables (within a single word)
+static const TTWORD TT_PATTERNS[6] = {
+  0xAAAAAAAAAAAAAAAAUL,
+  0xCCCCCCCCCCCCCCCCUL,
+  0xF0F0F0F0F0F0F0F0UL,
+  0xFF00FF00FF00FF00UL,
+  0xFFFF0000FFFF0000UL,
+  0xFFFFFFFF00000000UL
+};
+
+static c2dSize tt_threshold;  //maximum number of free variables in a truth table
+static BYTE* tt_index;        //tt_index[i]: 1+index of variable i in the truth table (0 if not in table)
+static Var** tt_vars;         //variables of the current truth table
+static Clause** tt_clauses;   //live clauses of the current truth table
+static c2dSize tt_count;      //number of nodes counted using truth tables
+
+static TTWORD tt_table[TT_MAX_WORDS];
+static TTWORD tt_clause_table[TT_MAX_WORDS];
+
+/******************************************************************************
+ * setting up and tearing down
+ ******************************************************************************/
+
+void tt_setup(const SatState* sat_state, c2dSize threshold) {
+  tt_threshold = threshold;
+  tt_count     = 0;
+  tt_index     = (BYTE*) calloc(sat_var_count(sat_state)+1,sizeof(BYTE));
+  tt_vars      = (Var**) malloc(TT_MAX_VARS*sizeof(Var*));
+  tt_clauses   = (Clause**) malloc(sat_clause_count(sat_state)*sizeof(Clause*));
+}
+
+void tt_teardown() {
+  free(tt_index);
+  free(tt_vars);
+  free(tt_clauses);
+}
+
+//returns the number of vtree nodes counted using truth tables
+c2dSize tt_counted_nodes() {
+  return tt_count;
+}
+
+/******************************************************************************
+ * building truth tables
+ ******************************************************************************/
+
+//returns 1 if some clause mentioning the free variable is not subsumed, 0 otherwise
+static BOOLEAN live_var(const Var* var) {
+  c2dSize occurences = sat_var_occurences(var);
+  for(c2dSize i=0; i<occurences; i++)
+    if(!sat_subsumed_clause(sat_clause_of_var(i,var))) return 1;
+  return 0;
+}
+
+//ors the truth table of literal (whose variable has index i in the table) into table
+static inline void or_literal(TTWORD* table, c2dSize words, c2dSize i, BOOLEAN positive) {
+  TTWORD flip = positive? 0: ~(TTWORD)0;
+  if(i<6) {
+    TTWORD pattern = TT_PATTERNS[i]^flip;
+    for(c2dSize w=0; w<words; w++) table[w] |= pattern;
+  }
+  else {
+    for(c2dSize w=0; w<words; w++) table[w] |= ((w>>(i-6))&1? ~(TTWORD)0: 0)^flip;
+  }
+}
+
+//ands the truth table of clause into tt_table
+//returns 0 if the clause mentions a free variable outside the table, 1 otherwise
+static BOOLEAN and_clause(const Clause* clause, c2dSize words) {
+  Lit** literals = sat_clause_literals(clause);
+  c2dSize size   = sat_clause_size(clause);
+
+  for(c2dSize w=0; w<words; w++) tt_clause_table[w] = 0;
+  for(c2dSize j=0; j<size; j++) {
+    Lit* lit = literals[j];
+    Var* var = sat_literal_var(lit);
+    if(sat_instantiated_var(var)) {
+      if(sat_implied_literal(lit)) return 1; //clause is satisfied
+      continue; //literal is false
+    }
+    BYTE index = tt_index[sat_var_index(var)];
+    if(index==0) return 0; //free variable outside the table
+    or_literal(tt_clause_table,words,index-1,sat_literal_index(lit)>0);
+  }
+  for(c2dSize w=0; w<words; w++) tt_table[w] &= tt_clause_table[w];
+  return 1;
+}
+
+/******************************************************************************
+ * counting with truth tables
+ ******************************************************************************/
+
+//return 1 if the models of the vtree node were counted using a truth table, 0 otherwise
+//if counting is successful, set the value of count accordingly
+BOOLEAN tt_count_vtree(c2dWmc* count, const FVtree* node) {
+  c2dSize var_count  = 0; //free variables in table
+  c2dSize clause_count = 0;
+  c2dWmc weight      = 1; //weight of variables outside table
+  BOOLEAN success    = 0;
+
+  //collect live free variables, and the weight of the remaining variables
+  for(const FVtree* leaf=node; leaf<FV_END(node); leaf++) {
+    if(!FV_IS_LEAF(leaf)) continue;
+    Var* var  = leaf->var;
+    Lit* plit = sat_pos_literal(var);
+    Lit* nlit = sat_neg_literal(var);
+    if(sat_implied_literal(plit))      weight *= sat_literal_weight(plit);
+    else if(sat_implied_literal(nlit)) weight *= sat_literal_weight(nlit);
+    else if(!live_var(var))            weight *= sat_literal_weight(plit)+sat_literal_weight(nlit);
+    else {
+      if(var_count==tt_threshold) goto done; //too many free variables
+      if(sat_literal_weight(plit)!=1 || sat_literal_weight(nlit)!=1) goto done;
+      tt_vars[var_count++] = var;
+      tt_index[sat_var_index(var)] = var_count;
+    }
+  }
+
+  //collect live clauses of free variables
+  for(c2dSize i=0; i<var_count; i++) {
+    Var* var = tt_vars[i];
+    c2dSize occurences = sat_var_occurences(var);
+    for(c2dSize j=0; j<occurences; j++) {
+      Clause* clause = sat_clause_of_var(j,var);
+      if(sat_subsumed_clause(clause) || sat_marked_clause(clause)) continue;
+      sat_mark_clause(clause);
+      tt_clauses[clause_count++] = clause;
+    }
+  }
+
+  //evaluate clauses over the truth table
+  c2dSize words = var_count<=6? 1: 1UL<<(var_count-6);
+  for(c2dSize w=0; w<words; w++) tt_table[w] = ~(TTWORD)0;
+  for(c2dSize i=0; i<clause_count; i++)
+    if(!and_clause(tt_clauses[i],words)) goto done;
+  if(var_count<6) tt_table[0] &= (1UL<<(1UL<<var_count))-1; //ignore padded assignments
+
+  c2dSize models = 0;
+  for(c2dSize w=0; w<words; w++) models += __builtin_popcountl(tt_table[w]);
+  *count  = weight*models;
+  success = 1;
+  ++tt_count;
+
+  done:
+  for(c2dSize i=0; i<clause_count; i++) sat_unmark_clause(tt_clauses[i]);
+  for(c2dSize i=0; i<var_count; i++) tt_index[sat_var_index(tt_vars[i])] = 0;
+  return success;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -65,10 +65,22 @@ typedef double c2dWmc;          //for (weighted) model count
 #define ARRAY_S_END(name)   ((name).item + (name).size)
 #define ARRAY_C_END(name)   ((name).item + (name).count)
 
+//appends an item to an array whose size grows (doubles) as needed
+#define PUSH_ARRAY(name, type, x) do { \
+  if((name).count == (name).size) { \
+    (name).size = 2 * (name).size + 4; \
+    (name).item = (type*) realloc((name).item, (name).size * sizeof(type)); \
+  } \
+  (name).item[(name).count++] = (x); \
+} while(0)
+
 typedef struct var Var;
 typedef struct literal Lit;
 typedef struct clause Clause;
 typedef struct sat_state_t SatState;
+typedef struct xor_matrix_t XorMatrix;
+
+typedef ARRAY(Clause*) ClauseArray;
 
 /******************************************************************************
  * Literals:
@@ -78,6 +90,11 @@ typedef struct sat_state_t SatState;
  * --Index of a literal must be of type "c2dLiteral"
  ******************************************************************************/
 
+//watched clauses are kept in one list per size class, each propagated by its own kernel:
+//binary (and unit), ternary, short (up to 8 literals) and long clauses
+#define WATCH_CLASSES 4
+#define WATCH_CLASS(size) ((size) <= 2 ? 0 : (size) == 3 ? 1 : (size) <= 8 ? 2 : 3)
+
 typedef struct literal {
   c2dLiteral id;
 
@@ -85,8 +102,8 @@ typedef struct literal {
 
   ARRAY(Clause*) appears_in;                        // NOT owner
 
-  LIST_HEAD(, ClauseListNode) watch_list;           // NOT owner
-  LIST_HEAD(, ClauseListNode) learned_list;         // NOT owner
+  ClauseArray watches[WATCH_CLASSES];               // NOT owner (arrays are owner), by WATCH_CLASS() of clause size
+  ClauseArray learned_in;                           // NOT owner (array is owner), learned clauses mentioning the literal
 } Lit;
 
 typedef struct LitListNode {
@@ -113,6 +130,8 @@ typedef struct var {
     Var* dominator;                                 // NOT owner
   } decision;
 
+  BOOLEAN phase;                                    // saved value: the last value undone (true initially), see sat_local_search()
+
   BOOLEAN mark;                                     //THIS FIELD MUST STAY AS IS
 } Var;
 
@@ -131,15 +150,28 @@ typedef struct clause {
 
   ARRAY(Lit*) lits;                                 // NOT owner
   Lit* watch_a, * watch_b;
+  c2dSize search;                                   // position where the last search for a literal to watch stopped (long clauses)
 
   BOOLEAN is_subsumed;
+  BOOLEAN vivified;                                 // learned clause already shortened, see sat_vivify_learned_clauses()
   BOOLEAN mark;                                     //THIS FIELD MUST STAY AS IS
 } Clause;
 
-typedef struct ClauseListNode {
-  Clause* clause;                                   // NOT owner
-  LIST_ENTRY(ClauseListNode) link;
-} ClauseListNode;
+/******************************************************************************
+ * ClauseRegion:
+ * --learned clauses are bump allocated in blocks, each followed by its literals
+ *   (so a clause is one allocation, and neighbors in time are neighbors in memory)
+ * --a learned clause that is not asserted gives its space back to the next one
+ * --space of deleted clauses (and of literals dropped by vivification) is only
+ *   recovered by compacting the region, see sat_compact_learned_clauses()
+ ******************************************************************************/
+
+typedef struct clause_region_t {
+  ARRAY(char*) blocks;                              // owner, blocks of block_size bytes
+  c2dSize block_size;                               // at least the size of a clause over all variables
+  c2dSize used;                                     // bytes used in the last block
+  Clause* pending;                                  // last learned clause, unless asserted since
+} ClauseRegion;
 
 /******************************************************************************
  * SatState:
@@ -157,14 +189,49 @@ typedef struct sat_state_t {
 
   ARRAY(Var) vars;                                  // owner
   ARRAY(Clause) clauses;                            // owner
+  ARRAY(Lit*) lit_arena;                            // owner, literals of the cnf clauses (in clause order)
+  ARRAY(Clause*) occurrence_arena;                  // owner, clauses mentioning each literal (in literal order)
 
   ARRAY(Lit*) decided_literals;                     // NOT owner
   ARRAY(Lit*) propagate_literals;                   // NOT owner
 
-  LIST_HEAD(, ClauseListNode) learned_clauses;      // owner
-  LIST_HEAD(, ClauseListNode) subsumed_clauses;     // owner
+  ClauseRegion learned_region;                      // owner
+  ClauseArray learned_clauses;                      // NOT owner (array is owner), asserted learned clauses (in the order learned)
+  ClauseArray subsumed_clauses;                     // NOT owner (array is owner), by level (each level starts with NULL)
+
+  XorMatrix* xors;                                  // owner (NULL unless XORs were recovered or pushed)
+
+  c2dSize chronological;                            // backjumps over more levels backtrack one level (0 disables)
 } SatState;
 
+/******************************************************************************
+ * XorMatrix:
+ * --XOR constraints recovered from their CNF encodings (or pushed), as the rows of
+ *   a packed bit matrix over the variables they mention (one column per variable)
+ * --rows are kept in reduced form: the pivot column of a row appears in no other
+ *   row, and pivots are moved to unassigned columns lazily (during propagation)
+ * --an implication (or a contradiction) found by the matrix is explained by a
+ *   reason clause, which is freed when its decision level is undone
+ ******************************************************************************/
+
+typedef struct xor_matrix_t {
+  ARRAY(c2dSize) constraint_vars;                   // owner, variable indices of each constraint, each followed by 0
+  ARRAY(BOOLEAN) constraint_parity;                 // owner, parity of each constraint (recovered ones first)
+  c2dSize recovered;                                // number of recovered constraints
+
+  c2dSize rows, cols, words;                        // words per row
+
+  Var** vars;                                       // NOT owner (array is owner), variable of each column
+  unsigned long* bits;                              // owner, row r starts at bits + r * words
+  BOOLEAN* parity;                                  // owner, right hand side of each row
+  c2dSize* pivot;                                   // owner, pivot column of each row (cols if none)
+
+  unsigned long* free_cols;                         // owner, columns of unassigned variables
+  unsigned long* true_cols;                         // owner, columns of variables set to true
+
+  ARRAY(Clause*) reasons;                           // owner, reason clauses (by decision level)
+} XorMatrix;
+
 /******************************************************************************
  * API:
  * --Using the above structures you must implement the following functions
@@ -241,6 +308,14 @@ Clause* sat_decide_literal(Lit* lit, SatState*);
 //undoes the last literal decision and the corresponding implications obtained by unit resolution
 void sat_undo_decide_literal(SatState*);
 
+//returns the number of instantiated literals (decided or implied), which are kept in the order
+//of their instantiation, so the literals of a decision level follow those of lower levels
+//after a contradiction, the last one is the literal of the contradiction (with index 0)
+c2dSize sat_trail_size(const SatState*);
+
+//returns the index^th instantiated literal (index starts from 0)
+Lit* sat_trail_literal(c2dSize, const SatState*);
+
 /******************************************************************************
  * Clauses
  ******************************************************************************/
@@ -277,6 +352,18 @@ Clause* sat_build_asserting_clause(SatState* sat_state);
 //moreover, it should be called only if sat_at_assertion_level() succeeds
 Clause* sat_assert_clause(Clause*, SatState*);
 
+//frees a clause returned by sat_decide_literal() instead of asserting it
+//(a learned clause must be asserted or discarded before another clause is learned)
+void sat_discard_clause(Clause*);
+
+//deletes learned clauses, keeping the keep most recently learned ones, older ones of at most 3
+//literals, and the ones implying literals, then compacts the region of learned clauses (learned
+//clauses move, and are numbered again in the order learned)
+//returns the number of learned clauses deleted
+//
+//this is called at decision level 1, after unit resolution succeeds
+c2dSize sat_compact_learned_clauses(c2dSize keep, SatState*);
+
 /******************************************************************************
  * SatState
  ******************************************************************************/
@@ -287,21 +374,106 @@ SatState* sat_state_new(const char*);
 //frees the SatState
 void sat_state_free(SatState*);
 
+//recovers XOR constraints from their encodings in the cnf of sat state (all clauses
+//over the same variables that exclude the assignments of one parity), which are then
+//propagated by Gauss-Jordan elimination along with unit resolution
+//returns the number of XOR constraints recovered
+//
+//this can only be called before any literal is decided and before any clause is learned
+c2dSize sat_recover_xors(SatState*);
+
+//adds an XOR constraint over variables (given by their indices), which holds when the number
+//of true variables has the given parity (1 for odd)
+//
+//this can only be called before unit resolution (or after it is undone)
+void sat_push_xor(const c2dSize* vars, c2dSize size, BOOLEAN parity, SatState*);
+
+//removes the last XOR constraint added by sat_push_xor()
+//
+//this can only be called before unit resolution (or after it is undone), and no clause learned
+//since the constraint was added should have been asserted (as it may depend on the constraint)
+void sat_pop_xor(SatState*);
+
+//returns the rank of the XOR constraints over the unassigned variables (so the unassigned
+//variables have 2^(count-rank) assignments satisfying the XOR constraints)
+//
+//this is called after unit resolution succeeds
+c2dSize sat_xor_rank(const SatState*);
+
 //applies unit resolution to the cnf of sat state
 //returns 1 if unit resolution succeeds, 0 if it finds a contradiction
 BOOLEAN sat_unit_resolution(SatState*);
 
 //undoes sat_unit_resolution(), leading to un-instantiating variables that have been instantiated
 //after sat_unit_resolution()
+//
+//at decision level 1, the sat state is back to its initial state (unit resolution can be applied again)
 void sat_undo_unit_resolution(SatState*);
 
 //returns 1 if the decision level of the sat state equals to the assertion level of clause,
-//0 otherwise
+//0 otherwise (with chronological backtracking, also 1 one level below the level where clause was
+//learned, if backjumping to its assertion level would undo too many levels)
 //
 //this function is called after sat_decide_literal() or sat_assert_clause() returns clause.
 //it is used to decide whether the sat state is at the right decision level for adding clause.
 BOOLEAN sat_at_assertion_level(const Clause*, const SatState*);
 
+//enables chronological backtracking: a learned clause whose assertion level is more than
+//threshold levels below the level where it was learned is asserted one level below that level
+//(threshold 0 disables it, and learned clauses are asserted at their assertion levels)
+void sat_set_chronological_backtracking(c2dSize threshold, SatState*);
+
+/******************************************************************************
+ * Stochastic local search (see sls.c)
+ ******************************************************************************/
+
+//searches for a model of the cnf clauses of sat state by ProbSAT, starting from the saved
+//phases of variables and making at most flips flips (seed initializes its random choices)
+//returns 1 if a model is found, 0 otherwise
+//the model, or else the best assignment found (fewest falsified clauses), becomes the saved phases
+//
+//this ignores the decisions of the sat state (so it can be called at any decision level)
+BOOLEAN sat_local_search(c2dSize flips, unsigned long seed, SatState*);
+
+//returns the literal of a variable that agrees with its saved phase
+//(the value of the variable when it was last un-instantiated, or found by local search)
+Lit* sat_phase_literal(const Var*);
+
+/******************************************************************************
+ * Vivification (see vivify.c)
+ ******************************************************************************/
+
+//shortens learned clauses that were not vivified before, from the most recently learned, by
+//deciding the negations of their literals until the clause is implied by the decided ones
+//(literals implied false by earlier ones are dropped, as are the literals after the one that
+//becomes implied or contradicts), stopping when the literals implied by these decisions
+//exceed budget
+//returns the number of literals removed from learned clauses
+//
+//this is called at decision level 1, after unit resolution succeeds
+c2dSize sat_vivify_learned_clauses(c2dSize budget, SatState*);
+
+/******************************************************************************
+ * Huge page regions (see huge.c)
+ ******************************************************************************/
+
+//returns a zeroed array of bytes, backed by huge pages where available (NULL if memory is exhausted)
+void* sat_huge_alloc(size_t bytes);
+
+//resizes an array of old_bytes to new_bytes, keeping its contents (the added bytes are zeroed)
+void* sat_huge_realloc(void*, size_t old_bytes, size_t new_bytes);
+
+//frees an array of bytes returned by sat_huge_alloc() or sat_huge_realloc()
+void sat_huge_free(void*, size_t bytes);
+
+//interleaves the pages of an array of bytes returned by sat_huge_alloc() or sat_huge_realloc()
+//over the NUMA nodes, unless a memory policy was set for the process (e.g., by numactl)
+void sat_huge_interleave(void*, size_t bytes);
+
+//pages of an array of bytes returned by sat_huge_alloc() or sat_huge_realloc() that are placed
+//from now on land on the NUMA node of the process writing them
+void sat_huge_local(void*, size_t bytes);
+
 /******************************************************************************
  * The functions below are already implemented for you and MUST STAY AS IS
  ******************************************************************************/
@@ -0,0 +1,151 @@
+#define _DEFAULT_SOURCE //MAP_ANONYMOUS, MAP_HUGETLB, MADV_HUGEPAGE, syscall
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "sat_api.h"
+
+/******************************************************************************
+ * Huge page regions:
+ * --large arrays (the clause and occurrence arenas here, the cache tables and key
+ *   arenas of c2D) are mapped directly, so that they can be backed by huge pages:
+ *   one TLB entry then covers HUGE_PAGE_SIZE bytes instead of a base page
+ * --a region is first requested from the explicit huge page pool (MAP_HUGETLB),
+ *   which fails unless pages were reserved by the administrator; it is otherwise
+ *   mapped with base pages, aligned to HUGE_PAGE_SIZE and advised as a candidate
+ *   for transparent huge pages (MADV_HUGEPAGE)
+ * --where neither is available, the region is an ordinary mapping, and arrays
+ *   smaller than HUGE_PAGE_SIZE are left to malloc
+ *
+ * The size of a region is not stored: it must be passed back when the region is
+ * resized or freed (it decides whether the region was mapped or malloced).
+ *
+ * On NUMA machines, mapped regions are not touched when allocated, so each page
+ * lands on the node of the process that first writes it (see NUMA placement below).
+ ******************************************************************************/
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+#define HUGE_ROUND(bytes) (((bytes) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1))
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static void* map_region(size_t length) {
+#ifdef MAP_HUGETLB
+  void* region = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if(region != MAP_FAILED) return region;
+#endif
+
+  //over-map by one huge page, then unmap the unaligned head and the tail
+  char* base = mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(base == MAP_FAILED) return NULL;
+  char* aligned = (char*) HUGE_ROUND((size_t) base);
+  if(aligned > base) munmap(base, aligned - base);
+  munmap(aligned + length, base + HUGE_PAGE_SIZE - aligned);
+
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+//returns a zeroed array of bytes (NULL if memory is exhausted)
+void* sat_huge_alloc(size_t bytes) {
+  if(bytes < HUGE_PAGE_SIZE) return calloc(bytes ? bytes : 1, 1);
+  return map_region(HUGE_ROUND(bytes)); //mappings are zeroed
+}
+
+//frees an array returned by sat_huge_alloc() or sat_huge_realloc() for the same bytes
+void sat_huge_free(void* region, size_t bytes) {
+  if(region == NULL) return;
+  if(bytes < HUGE_PAGE_SIZE) free(region);
+  else munmap(region, HUGE_ROUND(bytes));
+}
+
+//resizes an array of old_bytes to new_bytes, keeping its contents (the added bytes are zeroed)
+void* sat_huge_realloc(void* region, size_t old_bytes, size_t new_bytes) {
+  if(region == NULL) return sat_huge_alloc(new_bytes);
+  if(old_bytes < HUGE_PAGE_SIZE && new_bytes < HUGE_PAGE_SIZE) {
+    char* resized = realloc(region, new_bytes ? new_bytes : 1);
+    if(resized != NULL && new_bytes > old_bytes) memset(resized + old_bytes, 0, new_bytes - old_bytes);
+    return resized;
+  }
+  if(old_bytes >= HUGE_PAGE_SIZE && new_bytes >= HUGE_PAGE_SIZE && HUGE_ROUND(old_bytes) == HUGE_ROUND(new_bytes)) {
+    if(new_bytes < old_bytes) memset((char*) region + new_bytes, 0, old_bytes - new_bytes); //kept zeroed for regrowing
+    return region;
+  }
+
+  void* resized = sat_huge_alloc(new_bytes);
+  if(resized == NULL) return NULL;
+  memcpy(resized, region, old_bytes < new_bytes ? old_bytes : new_bytes);
+  sat_huge_free(region, old_bytes);
+  return resized;
+}
+
+/******************************************************************************
+ * NUMA placement (Linux):
+ * --a region filled before forking workers on several nodes (the cache tables of
+ *   c2D) is read by all of them: it is interleaved over the nodes the process may
+ *   use, moving its pages already placed
+ * --a forked worker then resets the policy of the region, so the pages it copies
+ *   on write land on its own node (where it runs)
+ * --nothing is done on a single node, or if a memory policy was set for the
+ *   process (numactl --interleave, --membind, --preferred or --localalloc), which
+ *   then places all pages
+ *
+ * Policies are set with the mbind system call (libnuma is not needed), and a
+ * failure to set one is ignored: pages are then placed as before.
+ ******************************************************************************/
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_get_mempolicy)
+
+#define MPOL_DEFAULT 0
+#define MPOL_INTERLEAVE 3
+#define MPOL_F_MEMS_ALLOWED (1 << 2)
+#define MPOL_MF_MOVE (1 << 1)
+
+#define MAX_NUMA_NODES 1024
+#define MASK_WORDS (MAX_NUMA_NODES / (8 * sizeof(unsigned long)))
+
+//returns the number of nodes the process may place pages on, and sets their mask
+//returns 0 if a memory policy was set for the process (e.g., by numactl)
+static int numa_nodes(unsigned long* mask) {
+  int mode;
+  if(syscall(SYS_get_mempolicy, &mode, NULL, 0, NULL, 0) != 0 || mode != MPOL_DEFAULT) return 0;
+  if(syscall(SYS_get_mempolicy, NULL, mask, MAX_NUMA_NODES, NULL, MPOL_F_MEMS_ALLOWED) != 0) return 0;
+  int count = 0;
+  for(int i = 0; i < MASK_WORDS; ++i) count += __builtin_popcountl(mask[i]);
+  return count;
+}
+
+//interleaves a region returned by sat_huge_alloc() or sat_huge_realloc() for bytes over the
+//nodes, unless it was malloced
+void sat_huge_interleave(void* region, size_t bytes) {
+  unsigned long mask[MASK_WORDS] = {0};
+  if(region == NULL || bytes < HUGE_PAGE_SIZE || numa_nodes(mask) < 2) return;
+  syscall(SYS_mbind, region, HUGE_ROUND(bytes), MPOL_INTERLEAVE, mask, MAX_NUMA_NODES + 1, MPOL_MF_MOVE);
+}
+
+//pages of a region returned by sat_huge_alloc() or sat_huge_realloc() for bytes that are
+//placed from now on land on the node of the process writing them (pages already placed stay)
+void sat_huge_local(void* region, size_t bytes) {
+  unsigned long mask[MASK_WORDS] = {0};
+  if(region == NULL || bytes < HUGE_PAGE_SIZE || numa_nodes(mask) < 2) return;
+  syscall(SYS_mbind, region, HUGE_ROUND(bytes), MPOL_DEFAULT, NULL, 0, 0);
+}
+
+#else
+
+void sat_huge_interleave(void* region, size_t bytes) {}
+
+void sat_huge_local(void* region, size_t bytes) {}
+
+#endif
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
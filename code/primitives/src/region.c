@@ -0,0 +1,159 @@
+#include "sat_api.h"
+
+/******************************************************************************
+ * Region of learned clauses:
+ * --a learned clause is bump allocated with its literals right after it, in blocks
+ *   obtained from sat_huge_alloc(), so learning a clause costs no call to malloc
+ *   (clause references live in the growable arrays of literals and of the sat state)
+ * --the last clause built gives its space back to the next one unless it was
+ *   asserted in between (discarded clauses and clauses never asserted)
+ * --clauses are only deleted by compaction: the kept clauses are copied, in the
+ *   order learned, to new blocks, and every reference to a learned clause (reasons
+ *   at level 1, watches, learned clauses of literals, subsumed clauses) is redirected
+ *   or dropped; the old blocks are then freed as a whole
+ *
+ * Learned clauses are numbered in the order learned, after the cnf clauses, so the
+ * position of a learned clause is found from its index (also in its old copy).
+ ******************************************************************************/
+
+#define REGION_BLOCK_SIZE (2UL << 20)
+
+#define CLAUSE_BYTES(lit_count) (sizeof(Clause) + (lit_count) * sizeof(Lit*))
+
+//huge.c
+void* sat_huge_alloc(size_t);
+void sat_huge_free(void*, size_t);
+
+void init_ClauseRegion(ClauseRegion* region, c2dSize var_count) {
+  INIT_ARRAY(region->blocks, char*, 0);
+  region->block_size = REGION_BLOCK_SIZE;
+  while(region->block_size < CLAUSE_BYTES(var_count)) region->block_size *= 2; //a learned clause mentions each variable once
+  region->used = 0;
+  region->pending = NULL;
+}
+
+void free_ClauseRegion(ClauseRegion* region) {
+  for(char** block = ARRAY_BEGIN(region->blocks); block < ARRAY_C_END(region->blocks); ++block)
+    sat_huge_free(*block, region->block_size);
+  FREE_ARRAY(region->blocks);
+}
+
+//allocates a clause with room for lit_count literals (and no literal yet)
+static Clause* allocate_clause(ClauseRegion* region, c2dSize lit_count) {
+  c2dSize bytes = CLAUSE_BYTES(lit_count);
+  if(region->blocks.count == 0 || region->used + bytes > region->block_size) {
+    PUSH_ARRAY(region->blocks, char*, sat_huge_alloc(region->block_size));
+    region->used = 0;
+  }
+  Clause* clause = (Clause*) (region->blocks.item[region->blocks.count - 1] + region->used);
+  region->used += bytes;
+
+  clause->lits.item = (Lit**) (clause + 1);
+  clause->lits.size = lit_count;
+  clause->lits.count = 0;
+  return clause;
+}
+
+//returns a new learned clause with index id and room for lit_count literals (and no literal yet)
+Clause* region_clause(ClauseRegion* region, c2dSize id, c2dSize lit_count) {
+  if(region->pending != NULL) //not asserted: the last allocation of the region
+    region->used = (char*) region->pending - region->blocks.item[region->blocks.count - 1];
+
+  Clause* clause = allocate_clause(region, lit_count);
+  clause->id = id;
+  clause->mark = false;
+  clause->is_subsumed = false;
+  clause->vivified = false;
+  clause->watch_a = clause->watch_b = NULL;
+  clause->search = 0;
+  region->pending = clause;
+  return clause;
+}
+
+/******************************************************************************
+ * Compaction
+ ******************************************************************************/
+
+static c2dSize learned_position(const Clause* clause, const SatState* sat_state) {
+  return clause->id - sat_state->clauses.size - 1;
+}
+
+static BOOLEAN learned_clause(const Clause* clause, const SatState* sat_state) {
+  return clause->id > sat_state->clauses.size; //reasons of xors have index 0
+}
+
+//keeps the references of clauses that are kept (redirected to their copies)
+static void move_references(ClauseArray* clauses, Clause** moved, const SatState* sat_state) {
+  c2dSize kept = 0;
+  for(Clause** clause = ARRAY_BEGIN(*clauses); clause < ARRAY_C_END(*clauses); ++clause) {
+    if(*clause == NULL || !learned_clause(*clause, sat_state)) clauses->item[kept++] = *clause;
+    else if(moved[learned_position(*clause, sat_state)]) clauses->item[kept++] = moved[learned_position(*clause, sat_state)];
+  }
+  clauses->count = kept;
+}
+
+//deletes learned clauses, keeping the keep most recently learned ones, older ones of at most 3
+//literals, and the ones implying literals, then compacts the region of learned clauses (learned
+//clauses move, and are numbered again in the order learned)
+//returns the number of learned clauses deleted
+//
+//this is called at decision level 1, after unit resolution succeeds
+c2dSize sat_compact_learned_clauses(c2dSize keep, SatState* sat_state) {
+  assert(sat_state->level == 1);
+  ClauseRegion* region = &(sat_state->learned_region);
+  ClauseArray* learned = &(sat_state->learned_clauses);
+  c2dSize count = learned->count;
+
+  //moved[k] is the copy of the k^th learned clause (NULL if deleted), first the clause if kept
+  Clause** moved = calloc(count + 1, sizeof(Clause*));
+  for(c2dSize k = 0; k < count; ++k) {
+    Clause* clause = learned->item[k];
+    if(k + keep >= count || clause->lits.count <= 3) moved[k] = clause;
+  }
+  for(Lit** lit = ARRAY_BEGIN(sat_state->decided_literals); lit < ARRAY_C_END(sat_state->decided_literals); ++lit) {
+    Clause* reason = (*lit)->var->decision.implied_by;
+    if(reason && learned_clause(reason, sat_state)) moved[learned_position(reason, sat_state)] = reason;
+  }
+
+  //copy the kept clauses to new blocks (the old ones still hold the old indices)
+  ClauseRegion old = *region;
+  INIT_ARRAY(region->blocks, char*, 0);
+  region->used = 0;
+  region->pending = NULL;
+  c2dSize kept = 0;
+  for(c2dSize k = 0; k < count; ++k) {
+    if(moved[k] == NULL) continue;
+    Clause* clause = allocate_clause(region, moved[k]->lits.count);
+    Lit** lits = clause->lits.item;
+    *clause = *moved[k];
+    clause->lits.item = lits;
+    memcpy(lits, moved[k]->lits.item, moved[k]->lits.count * sizeof(Lit*));
+    clause->lits.size = clause->lits.count;
+    moved[k] = clause;
+    ++kept;
+  }
+
+  //redirect references
+  for(Lit** lit = ARRAY_BEGIN(sat_state->decided_literals); lit < ARRAY_C_END(sat_state->decided_literals); ++lit) {
+    Clause* reason = (*lit)->var->decision.implied_by;
+    if(reason && learned_clause(reason, sat_state)) (*lit)->var->decision.implied_by = moved[learned_position(reason, sat_state)];
+  }
+  for(Var* var = ARRAY_BEGIN(sat_state->vars); var < ARRAY_C_END(sat_state->vars); ++var) {
+    for(int i = 0; i < 2; ++i) {
+      for(int c = 0; c < WATCH_CLASSES; ++c) move_references(var->lit[i].watches + c, moved, sat_state);
+      move_references(&(var->lit[i].learned_in), moved, sat_state);
+    }
+  }
+  move_references(&(sat_state->subsumed_clauses), moved, sat_state);
+  move_references(learned, moved, sat_state);
+
+  //number the kept clauses again, then free the old copies
+  for(c2dSize k = 0; k < kept; ++k) learned->item[k]->id = sat_state->clauses.size + k + 1;
+  free_ClauseRegion(&old);
+  free(moved);
+  return count - kept;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
@@ -31,8 +31,15 @@ void free_Clause(Clause*);
 LitListNode* init_LLN(Lit*);
 void free_LLN(LitListNode*);
 
-ClauseListNode* init_CLN(Clause*);
-void free_CLN(ClauseListNode*);
+//region.c
+void init_ClauseRegion(ClauseRegion*, c2dSize);
+void free_ClauseRegion(ClauseRegion*);
+Clause* region_clause(ClauseRegion*, c2dSize, c2dSize);
+
+//xor.c
+BOOLEAN sat_propagate_xors(SatState*);
+void sat_undo_xors(SatState*);
+void sat_xors_free(SatState*);
 
 
 /******************************************************************************
@@ -45,6 +52,7 @@ const int neg = false;
 void init_Var(Var* var, c2dSize id) {
   var->id = id;
   var->mark = false;
+  var->phase = true;
   var->decision.level = 0;
   init_Lit((var->lit) + pos, id, var);
   init_Lit((var->lit) + neg, -(c2dLiteral)id, var);
@@ -124,25 +132,21 @@ Clause* sat_clause_of_var(c2dSize index, const Var* var) {
 void init_Lit(Lit* lit, c2dLiteral id, Var* var) {
   lit->id = id;
   lit->var = var;
+  lit->appears_in.count = 0;
   lit->appears_in.size = 0;
   lit->appears_in.item = NULL;
-  LIST_INIT(&(lit->watch_list));
-  LIST_INIT(&(lit->learned_list));
+  for(int c = 0; c < WATCH_CLASSES; ++c) {
+    lit->watches[c].count = lit->watches[c].size = 0;
+    lit->watches[c].item = NULL;
+  }
+  lit->learned_in.count = lit->learned_in.size = 0;
+  lit->learned_in.item = NULL;
 }
 
+//the occurrences of a literal are a slice of the occurrence arena (freed with the sat state)
 void free_Lit(Lit* lit) {
-  FREE_ARRAY(lit->appears_in);
-
-  ClauseListNode* cln;
-  while(cln = lit->watch_list.lh_first) {
-    LIST_REMOVE(cln, link);
-    free_CLN(cln);
-  }
-
-  while(cln = lit->learned_list.lh_first) {
-    LIST_REMOVE(cln, link);
-    free_CLN(cln);
-  }
+  for(int c = 0; c < WATCH_CLASSES; ++c) FREE_ARRAY(lit->watches[c]);
+  FREE_ARRAY(lit->learned_in);
 }
 
 LitListNode* init_LLN(Lit* lit) {
@@ -163,28 +167,13 @@ void pprint_Lit(Lit* lit, BOOLEAN decision_info) {
             (lit->var->decision.level && lit->var->decision.implied_by)
               ? lit->var->decision.implied_by->id : 0);
     fprintf(stderr, " [");
-    for(ClauseListNode* cln = lit->watch_list.lh_first; cln != NULL; cln = cln->link.le_next)
-      fprintf(stderr, " %lu ", cln->clause->id);
+    for(int c = 0; c < WATCH_CLASSES; ++c)
+      for(Clause** clause = ARRAY_BEGIN(lit->watches[c]); clause < ARRAY_C_END(lit->watches[c]); ++clause)
+        fprintf(stderr, " %lu ", (*clause)->id);
     fprintf(stderr, "]\n");
   }
 }
 
-Lit* sat_unwatched_literal(Clause* clause, SatState* sat_state) {
-  Lit** l = ARRAY_BEGIN(clause->lits);
-  for(; l < ARRAY_S_END(clause->lits); ++l) {
-    if(sat_instantiated_var((*l)->var)) {
-      if(sat_implied_literal(*l)) {
-        sat_subsume_clause(clause, sat_state);
-        return NULL;
-      }
-      continue;
-    }
-    if(*l == clause->watch_a || *l == clause->watch_b)  continue;
-    break;
-  }
-  return (l < ARRAY_S_END(clause->lits) ? *l : NULL);
-}
-
 BOOLEAN sat_contradiction(Clause* implier, SatState* sat_state) {
   set_Var_Decision(&(sat_state->contradiction), sat_state->level, true, implier);
   sat_state->decided_literals.item[sat_state->decided_literals.count++] = (sat_state->contradiction.lit)+pos;
@@ -202,48 +191,192 @@ BOOLEAN set_Lit_Decision(Lit* lit, Clause* implier, SatState* sat_state) {
   return true;
 }
 
-BOOLEAN propagate_lit_decision(Lit* lit, SatState* sat_state) {
-  Var* var = lit->var;
+/******************************************************************************
+ * Propagation kernels:
+ * --when a watched literal becomes false, its clause needs another literal to
+ *   watch (one that is not false), and is subsumed if it finds a true one
+ * --the search differs by clause size: a binary clause has no other literal, a
+ *   ternary clause has one, a short clause is scanned by an unrolled sequence of
+ *   checks, and a long clause resumes scanning where its last search stopped
+ *   (circularly), instead of rescanning the false literals in front
+ * --clauses of each size class have their own watch lists, and each list is
+ *   propagated by a loop generated for its class (PROPAGATION_KERNEL), so the
+ *   search is chosen once per list instead of once per watch
+ ******************************************************************************/
 
-  for(Clause** clause = ARRAY_BEGIN(lit->appears_in); clause < ARRAY_S_END(lit->appears_in); ++clause)
-    sat_subsume_clause(*clause, sat_state);
-  for(ClauseListNode* cln = lit->learned_list.lh_first; cln != NULL; cln = cln->link.le_next)
-    sat_subsume_clause(cln->clause, sat_state);
+//returns l from the search of clause for a literal to watch, unless l is false or watched
+//(a true l subsumes clause, and the search ends with no literal)
+#define CHECK_UNWATCHED(l, clause, sat_state) do { \
+  Lit* l_ = (l); \
+  if(sat_instantiated_var(l_->var)) { \
+    if(sat_implied_literal(l_)) { \
+      sat_subsume_clause(clause, sat_state); \
+      return NULL; \
+    } \
+  } \
+  else if(l_ != (clause)->watch_a && l_ != (clause)->watch_b) return l_; \
+} while(0)
+
+static inline Lit* unwatched_binary(Clause* clause, SatState* sat_state) {
+  return NULL; //the other literal is the other watch
+}
+
+static inline Lit* unwatched_ternary(Clause* clause, SatState* sat_state) {
+  Lit** lits = clause->lits.item;
+  CHECK_UNWATCHED(lits[0], clause, sat_state);
+  CHECK_UNWATCHED(lits[1], clause, sat_state);
+  CHECK_UNWATCHED(lits[2], clause, sat_state);
+  return NULL;
+}
 
-  BOOLEAN delta = false;
-  Lit* clit = (var->lit) + (lit->id < 0);
-  for(ClauseListNode* cln = clit->watch_list.lh_first; cln != NULL; cln = delta ? cln : cln->link.le_next, delta = false) {
-    Clause* clause = cln->clause;
-    if(sat_subsumed_clause(clause)) continue;
+static inline Lit* unwatched_short(Clause* clause, SatState* sat_state) {
+  Lit** end = clause->lits.item + clause->lits.size; //literals are checked from the first
+  switch(clause->lits.size) { //falls through
+    case 8: CHECK_UNWATCHED(end[-8], clause, sat_state);
+    case 7: CHECK_UNWATCHED(end[-7], clause, sat_state);
+    case 6: CHECK_UNWATCHED(end[-6], clause, sat_state);
+    case 5: CHECK_UNWATCHED(end[-5], clause, sat_state);
+    default:
+      CHECK_UNWATCHED(end[-4], clause, sat_state);
+      CHECK_UNWATCHED(end[-3], clause, sat_state);
+      CHECK_UNWATCHED(end[-2], clause, sat_state);
+      CHECK_UNWATCHED(end[-1], clause, sat_state);
+  }
+  return NULL;
+}
+
+static inline Lit* unwatched_long(Clause* clause, SatState* sat_state) {
+  Lit** lits = clause->lits.item;
+  c2dSize size = clause->lits.size, start = clause->search;
+  for(c2dSize k = start; k < size; ++k) {
+    clause->search = k;
+    CHECK_UNWATCHED(lits[k], clause, sat_state);
+  }
+  for(c2dSize k = 0; k < start; ++k) {
+    clause->search = k;
+    CHECK_UNWATCHED(lits[k], clause, sat_state);
+  }
+  return NULL;
+}
 
-    Lit* l = sat_unwatched_literal(clause, sat_state);
-    if(sat_subsumed_clause(clause)) continue;
+/******************************************************************************
+ * Prefetching:
+ * --a watch only leads to its clause, whose literals lead to their variables,
+ *   so each of these misses would stall propagation when the watch is reached
+ * --kernels run a pipeline of prefetches ahead of the watch they propagate:
+ *   the clause header PREFETCH_DISTANCE watches ahead, the literal array (where
+ *   the search starts) and the other watched literal half as far, and the value
+ *   of that literal one watch ahead, so each stage only dereferences lines that
+ *   the previous stage prefetched
+ * --the clauses subsumed by a literal (its occurrences and learned clauses) are
+ *   prefetched PREFETCH_DISTANCE ahead as well
+ * --PREFETCH_DISTANCE can be set when building (-DPREFETCH_DISTANCE=...), and
+ *   0 disables prefetching
+ ******************************************************************************/
 
-    if(l) {
-      if(clit == clause->watch_a)     clause->watch_a = l;
-      else                            clause->watch_b = l;
+#ifndef PREFETCH_DISTANCE
+#define PREFETCH_DISTANCE 8
+#endif
+
+static inline Lit* other_watch(const Clause* clause, const Lit* clit) {
+  return clit == clause->watch_a ? clause->watch_b : clause->watch_a;
+}
+
+//issues the prefetches of the three stages for the watches after the i^th of n watches ws of clit
+#define PREFETCH_STAGES(ws, i, n, clit) do { \
+  if(PREFETCH_DISTANCE > 0) { \
+    if((i) + PREFETCH_DISTANCE < (n)) __builtin_prefetch((ws)[(i) + PREFETCH_DISTANCE]); \
+    if((i) + PREFETCH_DISTANCE / 2 < (n)) { \
+      Clause* c_ = (ws)[(i) + PREFETCH_DISTANCE / 2]; \
+      __builtin_prefetch(c_->lits.item + c_->search); \
+      __builtin_prefetch(other_watch(c_, clit)); \
+    } \
+    if((i) + 1 < (n)) { \
+      Lit* l_ = other_watch((ws)[(i) + 1], clit); \
+      if(l_) __builtin_prefetch(&(l_->var->decision)); \
+    } \
+  } \
+} while(0)
+
+//keeps the watches after the i^th of n watches (when propagation stops at the i^th), after the
+//kept ones before it
+static inline void keep_watches(ClauseArray* watches, c2dSize kept, c2dSize i, c2dSize n) {
+  memmove(watches->item + kept, watches->item + i + 1, (n - i - 1) * sizeof(Clause*));
+  watches->count = kept + n - i - 1;
+}
+
+//propagates the false literal clit to the clauses of one size class watching it (clauses that
+//find another literal to watch leave its watches, and the others are packed in place)
+//returns 0 if a contradiction is found, 1 otherwise
+#define PROPAGATION_KERNEL(name, size_class, unwatched) \
+static BOOLEAN name(Lit* clit, SatState* sat_state) { \
+  ClauseArray* watches = clit->watches + size_class; \
+  Clause** ws = watches->item; \
+  c2dSize n = watches->count, kept = 0; \
+  for(c2dSize k = 0; k < PREFETCH_DISTANCE && k < n; ++k) __builtin_prefetch(ws[k]); \
+\
+  for(c2dSize i = 0; i < n; ++i) { \
+    PREFETCH_STAGES(ws, i, n, clit); \
+    Clause* clause = ws[kept++] = ws[i]; \
+    if(sat_subsumed_clause(clause)) continue; \
+\
+    Lit* l = unwatched(clause, sat_state); \
+    if(sat_subsumed_clause(clause)) continue; \
+\
+    if(l) { \
+      if(clit == clause->watch_a)     clause->watch_a = l; \
+      else                            clause->watch_b = l; \
+\
+      --kept; \
+      PUSH_ARRAY(l->watches[size_class], Clause*, clause); \
+    } else { \
+      Lit* other_lit = other_watch(clause, clit); \
+      if(other_lit == NULL || sat_instantiated_var(other_lit->var)) { \
+        if(other_lit && sat_implied_literal(other_lit)) \
+          sat_subsume_clause(clause, sat_state); \
+        else { \
+          keep_watches(watches, kept, i, n); \
+          return sat_contradiction(clause, sat_state); \
+        } \
+      } else { \
+        if(!set_Lit_Decision(other_lit, clause, sat_state)) { \
+          keep_watches(watches, kept, i, n); \
+          return false; \
+        } \
+        sat_state->propagate_literals.item[sat_state->propagate_literals.count++] = other_lit; \
+      } \
+    } \
+  } \
+  watches->count = kept; \
+  return true; \
+}
+
+PROPAGATION_KERNEL(propagate_binary,  0, unwatched_binary)
+PROPAGATION_KERNEL(propagate_ternary, 1, unwatched_ternary)
+PROPAGATION_KERNEL(propagate_short,   2, unwatched_short)
+PROPAGATION_KERNEL(propagate_long,    3, unwatched_long)
+
+//watches lit in clause (in the watches of the size class of clause)
+void watch_clause(Lit* lit, Clause* clause) {
+  PUSH_ARRAY(lit->watches[WATCH_CLASS(clause->lits.size)], Clause*, clause);
+}
 
-      ClauseListNode* ncln = cln->link.le_next;
-      LIST_REMOVE(cln, link);
-      LIST_INSERT_HEAD(&(l->watch_list), cln, link);
+BOOLEAN propagate_lit_decision(Lit* lit, SatState* sat_state) {
+  Var* var = lit->var;
 
-      delta = true;
-      cln = ncln;
-    } else {
-      Lit* other_lit = (clit == clause->watch_a ? clause->watch_b : clause->watch_a);
-      if(other_lit == NULL || sat_instantiated_var(other_lit->var)) {
-        if(other_lit && sat_implied_literal(other_lit))
-          sat_subsume_clause(clause, sat_state);
-        else
-          return sat_contradiction(clause, sat_state);
-      } else {
-        if(!set_Lit_Decision(other_lit, clause, sat_state)) return false;
-        sat_state->propagate_literals.item[sat_state->propagate_literals.count++] = other_lit;
-      }
-    }
+  //clauses subsumed by lit (their headers are prefetched too)
+  for(Clause** clause = ARRAY_BEGIN(lit->appears_in); clause < ARRAY_S_END(lit->appears_in); ++clause) {
+    if(PREFETCH_DISTANCE > 0 && clause + PREFETCH_DISTANCE < ARRAY_S_END(lit->appears_in)) __builtin_prefetch(clause[PREFETCH_DISTANCE]);
+    sat_subsume_clause(*clause, sat_state);
+  }
+  for(Clause** clause = ARRAY_BEGIN(lit->learned_in); clause < ARRAY_C_END(lit->learned_in); ++clause) {
+    if(PREFETCH_DISTANCE > 0 && clause + PREFETCH_DISTANCE < ARRAY_C_END(lit->learned_in)) __builtin_prefetch(clause[PREFETCH_DISTANCE]);
+    sat_subsume_clause(*clause, sat_state);
   }
 
-  return true;
+  Lit* clit = (var->lit) + (lit->id < 0);
+  return propagate_binary(clit, sat_state) && propagate_ternary(clit, sat_state)
+      && propagate_short(clit, sat_state) && propagate_long(clit, sat_state);
 }
 
 //returns a literal structure for the corresponding index
@@ -280,8 +413,7 @@ BOOLEAN sat_implied_literal(const Lit* lit) {
 Clause* sat_decide_literal(Lit* lit, SatState* sat_state) {
   ++sat_state->level;
 
-  ClauseListNode* cln = init_CLN(NULL);
-  LIST_INSERT_HEAD(&(sat_state->subsumed_clauses), cln, link);
+  PUSH_ARRAY(sat_state->subsumed_clauses, Clause*, NULL);
 
   BOOLEAN passed = false;
   if(passed = set_Lit_Decision(lit, NULL, sat_state)) {
@@ -304,6 +436,14 @@ void sat_undo_decide_literal(SatState* sat_state) {
   --sat_state->level;
 }
 
+c2dSize sat_trail_size(const SatState* sat_state) {
+  return sat_state->decided_literals.count;
+}
+
+Lit* sat_trail_literal(c2dSize index, const SatState* sat_state) {
+  return sat_state->decided_literals.item[index];
+}
+
 /******************************************************************************
  * Clauses
  ******************************************************************************/
@@ -312,7 +452,9 @@ void init_Clause(Clause* clause, c2dSize id, c2dSize lit_count) {
   clause->id = id;
   clause->mark = false;
   clause->is_subsumed = false;
+  clause->vivified = false;
   clause->watch_a = clause->watch_b = NULL;
+  clause->search = 0;
   INIT_ARRAY(clause->lits, Lit*, lit_count);
 }
 
@@ -332,16 +474,6 @@ void pprint_Clause(Clause* clause, BOOLEAN all_info) {
   fprintf(stderr, "\n");
 }
 
-ClauseListNode* init_CLN(Clause* clause) {
-  ClauseListNode* cln = malloc(sizeof(ClauseListNode));
-    cln->clause = clause;
-  return cln;
-}
-
-void free_CLN(ClauseListNode* cln) {
-  free(cln);
-}
-
 //returns a clause structure for the corresponding index
 Clause* sat_index2clause(c2dSize index, const SatState* sat_state) {
   return sat_state->clauses.item + (index-1);
@@ -365,8 +497,7 @@ c2dSize sat_clause_size(const Clause* clause) {
 void sat_subsume_clause(Clause* clause, SatState* sat_state) {
   if(!clause->is_subsumed) {
     clause->is_subsumed = true;
-    ClauseListNode* cln = init_CLN(clause);
-    LIST_INSERT_HEAD(&(sat_state->subsumed_clauses), cln, link);
+    PUSH_ARRAY(sat_state->subsumed_clauses, Clause*, clause);
   }
 }
 
@@ -382,7 +513,7 @@ c2dSize sat_clause_count(const SatState* sat_state) {
 
 //returns the number of learned clauses in a sat state (0 when the sat state is constructed)
 c2dSize sat_learned_clause_count(const SatState* sat_state) {
-  return sat_state->learned_clauses.lh_first ? sat_state->learned_clauses.lh_first->clause->id - sat_state->clauses.count : 0;
+  return sat_state->learned_clauses.count;
 }
 
 Var* dominator(Var* var1, Var* var2) {
@@ -404,8 +535,9 @@ Var* sat_compute_UIP(SatState* sat_state) {
   }
 
   Lit** lit = ARRAY_BEGIN(sat_state->decided_literals) + last_decision;
-  (*lit)->var->decision.dominator = (*lit)->var;
-  (*lit)->var->decision.order = last_decision;
+  Var* decision = (*lit)->var;
+  decision->decision.dominator = decision;
+  decision->decision.order = last_decision;
 
   for(++lit; lit < ARRAY_C_END(sat_state->decided_literals); ++lit) {
     for(Lit** pred = ARRAY_BEGIN((*lit)->var->decision.implied_by->lits); pred < ARRAY_S_END((*lit)->var->decision.implied_by->lits); ++pred) {
@@ -415,15 +547,16 @@ Var* sat_compute_UIP(SatState* sat_state) {
       if((*lit)->var->decision.dominator == NULL)   (*lit)->var->decision.dominator = (*pred)->var;
       else                                          (*lit)->var->decision.dominator = dominator((*pred)->var, (*lit)->var->decision.dominator);
     }
+    //a literal implied by a clause asserted chronologically may have no predecessor at this level:
+    //it is treated as implied by the decision (its reason then joins the learned clause)
+    if((*lit)->var->decision.dominator == NULL) (*lit)->var->decision.dominator = decision;
   }
 
   return sat_state->contradiction.decision.dominator;
 }
 
-//builds an asserting clause from current SatState
+//builds an asserting clause from current SatState (in the region of learned clauses)
 Clause* sat_build_asserting_clause(SatState* sat_state) {
-  Clause* clause = malloc(sizeof(Clause));
-
   Var* uip = sat_compute_UIP(sat_state);
   c2dSize clause_size = 1;
 
@@ -441,7 +574,7 @@ Clause* sat_build_asserting_clause(SatState* sat_state) {
     --post_uip;
   }
 
-  init_Clause(clause, (sat_state->learned_clauses.lh_first ? sat_state->learned_clauses.lh_first->clause->id : sat_state->clauses.size) + 1, clause_size);
+  Clause* clause = region_clause(&(sat_state->learned_region), sat_state->clauses.size + sat_state->learned_clauses.count + 1, clause_size);
   clause->assertion_level = 1;
 
   if(clause_size > 1) {
@@ -468,13 +601,10 @@ c2dSize cnt = 0;
 //this function is called on a clause returned by sat_decide_literal() or sat_assert_clause()
 //moreover, it should be called only if sat_at_assertion_level() succeeds
 Clause* sat_assert_clause(Clause* clause, SatState* sat_state) {
-  ClauseListNode* cln = init_CLN(clause);
-  LIST_INSERT_HEAD(&(sat_state->learned_clauses), cln, link);
-
-  for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_S_END(clause->lits); ++lit) {
-    ClauseListNode* cln = init_CLN(clause);
-    LIST_INSERT_HEAD(&((*lit)->learned_list), cln, link);
-  }
+  sat_state->learned_region.pending = NULL;
+  PUSH_ARRAY(sat_state->learned_clauses, Clause*, clause);
+  for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_S_END(clause->lits); ++lit)
+    PUSH_ARRAY((*lit)->learned_in, Clause*, clause);
 
   clause->watch_a = clause->lits.item[0];
   clause->watch_b = clause->lits.item[clause->lits.size-1];
@@ -483,10 +613,8 @@ Clause* sat_assert_clause(Clause* clause, SatState* sat_state) {
   if(passed = set_Lit_Decision(clause->watch_a, clause, sat_state)) {
     sat_state->propagate_literals.item[sat_state->propagate_literals.count++] = clause->watch_a;
 
-    cln = init_CLN(clause);
-    LIST_INSERT_HEAD(&(clause->watch_a->watch_list), cln, link);
-    cln = init_CLN(clause);
-    LIST_INSERT_HEAD(&(clause->watch_b->watch_list), cln, link);
+    watch_clause(clause->watch_a, clause);
+    watch_clause(clause->watch_b, clause);
 
     passed = sat_unit_resolution(sat_state);
   }
@@ -501,6 +629,11 @@ Clause* sat_assert_clause(Clause* clause, SatState* sat_state) {
   return NULL;
 }
 
+//frees a clause returned by sat_decide_literal() instead of asserting it
+//(its space in the region is reused by the next learned clause)
+void sat_discard_clause(Clause* clause) {
+}
+
 /******************************************************************************
  * A SatState should keep track of pretty much everything you will need to
  * condition/uncondition variables, perform unit resolution, and do clause learning
@@ -530,6 +663,8 @@ void skip_comments(FILE *fp) {
   if(cursor != EOF) ungetc(cursor, fp);
 }
 
+//the literals of the clause are appended to the literal arena, which moves as it grows:
+//clauses point into the arena once the cnf is read
 void read_clause(Clause* clause, SatState* sat_state, FILE* fp) {
   char line[32767];
   c2dLiteral val;
@@ -554,65 +689,103 @@ void read_clause(Clause* clause, SatState* sat_state, FILE* fp) {
     }
   } while(!end);
 
-  init_Clause(clause, ++sat_state->clauses.count, sat_state->decided_literals.count);
-
-  for(Lit** lit = ARRAY_BEGIN(sat_state->decided_literals); lit < ARRAY_C_END(sat_state->decided_literals); ++lit)
-    clause->lits.item[clause->lits.count++] = *lit;
+  c2dSize lit_count = sat_state->decided_literals.count;
+  clause->id = ++sat_state->clauses.count;
+  clause->mark = false;
+  clause->is_subsumed = false;
+  clause->vivified = false;
+  clause->watch_a = clause->watch_b = NULL;
+  clause->search = 0;
+  clause->lits.item = NULL;
+  clause->lits.size = clause->lits.count = lit_count;
+
+  if(sat_state->lit_arena.count + lit_count > sat_state->lit_arena.size) {
+    c2dSize size = 2 * sat_state->lit_arena.size + lit_count;
+    sat_state->lit_arena.item = sat_huge_realloc(sat_state->lit_arena.item, sat_state->lit_arena.size * sizeof(Lit*), size * sizeof(Lit*));
+    sat_state->lit_arena.size = size;
+  }
+  memcpy(ARRAY_C_END(sat_state->lit_arena), ARRAY_BEGIN(sat_state->decided_literals), lit_count * sizeof(Lit*));
+  sat_state->lit_arena.count += lit_count;
 
   sat_state->decided_literals.count = 0;
 }
 
+//decides the literals of unit clauses at level 1, to be propagated by unit resolution
+//(until one of them contradicts the others)
+static void decide_unit_clauses(SatState* sat_state) {
+  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause) {
+    if(clause->lits.count > 1) continue;
+    if(sat_implied_literal(clause->watch_a)) { //a repeated unit: not queued again
+      sat_subsume_clause(clause, sat_state);
+      continue;
+    }
+
+    BOOLEAN passed = set_Lit_Decision(clause->watch_a, clause, sat_state);
+    if(!passed) {
+      --sat_state->decided_literals.count;
+      clause->is_subsumed = false;
+    }
+    sat_state->propagate_literals.item[sat_state->propagate_literals.count++] = clause->watch_a;
+    if(!passed) break;
+  }
+}
+
 SatState* read_sat_cnf(SatState* sat_state, FILE *fp) {
   skip_comments(fp);
   fscanf(fp, "p cnf %lu %lu\n", &sat_state->vars.size, &sat_state->clauses.size);
 
-  INIT_ARRAY(sat_state->vars, Var, sat_state->vars.size);
+  sat_state->vars.count = 0;
+  sat_state->vars.item = sat_huge_alloc(sat_state->vars.size * sizeof(Var));
   for(Var* v = ARRAY_BEGIN(sat_state->vars); v < ARRAY_S_END(sat_state->vars); ++v)
     init_Var(v, ++sat_state->vars.count);
 
-  LIST_INIT(&(sat_state->learned_clauses));
-  LIST_INIT(&(sat_state->subsumed_clauses));
+  INIT_ARRAY(sat_state->learned_clauses, Clause*, 0);
+  INIT_ARRAY(sat_state->subsumed_clauses, Clause*, 0);
+  init_ClauseRegion(&(sat_state->learned_region), sat_state->vars.size);
 
-  INIT_ARRAY(sat_state->propagate_literals, Lit*, sat_state->vars.size);
+  INIT_ARRAY(sat_state->propagate_literals, Lit*, sat_state->vars.size + 1); //with a contradicted unit
   INIT_ARRAY(sat_state->decided_literals, Lit*, sat_state->vars.size + 1);
 
-  INIT_ARRAY(sat_state->clauses, Clause, sat_state->clauses.size);
-  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause) {
+  sat_state->clauses.count = 0;
+  sat_state->clauses.item = sat_huge_alloc(sat_state->clauses.size * sizeof(Clause));
+  sat_state->lit_arena.count = 0;
+  sat_state->lit_arena.size = 0;
+  sat_state->lit_arena.item = NULL;
+  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause)
     read_clause(clause, sat_state, fp);
 
+  Lit** lits = ARRAY_BEGIN(sat_state->lit_arena);
+  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause) {
+    clause->lits.item = lits;
+    lits += clause->lits.count;
+
     clause->watch_a = *(clause->lits.item);
-    ClauseListNode* cln = init_CLN(clause);
-    LIST_INSERT_HEAD(&(clause->watch_a->watch_list), cln, link);
+    watch_clause(clause->watch_a, clause);
 
     if(clause->lits.count == 1) {
       clause->watch_b = NULL;
     } else {
       clause->watch_b = *(clause->lits.item + 1);
-      cln = init_CLN(clause);
-      LIST_INSERT_HEAD(&(clause->watch_b->watch_list), cln, link);
+      watch_clause(clause->watch_b, clause);
     }
   }
 
+  //every literal of a cnf clause is one occurrence
+  sat_state->occurrence_arena.size = sat_state->occurrence_arena.count = sat_state->lit_arena.count;
+  sat_state->occurrence_arena.item = sat_huge_alloc(sat_state->occurrence_arena.size * sizeof(Clause*));
+  Clause** occurrences = ARRAY_BEGIN(sat_state->occurrence_arena);
   for(Var* var = ARRAY_BEGIN(sat_state->vars); var < ARRAY_S_END(sat_state->vars); ++var) {
-    if(var->lit[pos].appears_in.size)  INIT_ARRAY(var->lit[pos].appears_in, Clause*, var->lit[pos].appears_in.size);
-    if(var->lit[neg].appears_in.size)  INIT_ARRAY(var->lit[neg].appears_in, Clause*, var->lit[neg].appears_in.size);
+    for(int i = 0; i < 2; ++i) {
+      var->lit[i].appears_in.item = occurrences;
+      occurrences += var->lit[i].appears_in.size;
+    }
   }
 
-  BOOLEAN passed = true;
-  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause) {
-    if(clause->lits.count > 1 || !passed) {
-      for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_S_END(clause->lits); ++lit)
-        (*lit)->appears_in.item[(*lit)->appears_in.count++] = clause;
-      continue;
-    }
+  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause)
+    for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_S_END(clause->lits); ++lit)
+      (*lit)->appears_in.item[(*lit)->appears_in.count++] = clause;
 
-    clause->watch_a->appears_in.item[clause->watch_a->appears_in.count++] = clause;
-    if(!(passed = set_Lit_Decision(clause->watch_a, clause, sat_state))) {
-      --sat_state->decided_literals.count;
-      clause->is_subsumed = false;
-    }
-    sat_state->propagate_literals.item[sat_state->propagate_literals.count++] = clause->watch_a;
-  }
+  decide_unit_clauses(sat_state);
 
   return sat_state;
 }
@@ -626,6 +799,8 @@ SatState* sat_state_new(const char* cnf_fname) {
   init_Lit(sat_state->contradiction.lit + pos, 0, &(sat_state->contradiction));
   init_Clause(&(sat_state->false_clause), 0, 0);
   sat_state->false_clause.assertion_level = 0;
+  sat_state->xors = NULL;
+  sat_state->chronological = 0;
 
   read_sat_cnf(sat_state, fp);
   sat_state->marks = calloc(sat_state->vars.size + 1, sizeof(BOOLEAN));
@@ -636,31 +811,23 @@ SatState* sat_state_new(const char* cnf_fname) {
 
 //frees the SatState
 void sat_state_free(SatState* sat_state) {
+  sat_xors_free(sat_state);
   free_Clause(&(sat_state->false_clause));
   free_Lit(sat_state->contradiction.lit + pos);
 
-  ClauseListNode* cln;
-  while(cln = sat_state->subsumed_clauses.lh_first) {
-    LIST_REMOVE(cln, link);
-    free_CLN(cln);
-  }
-
-  while(cln = sat_state->learned_clauses.lh_first) {
-    free_Clause(cln->clause);
-    free(cln->clause);
-    LIST_REMOVE(cln, link);
-    free_CLN(cln);
-  }
+  FREE_ARRAY(sat_state->subsumed_clauses);
+  FREE_ARRAY(sat_state->learned_clauses);
+  free_ClauseRegion(&(sat_state->learned_region));
 
-  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause)
-    free_Clause(clause);
-  FREE_ARRAY(sat_state->clauses);
+  sat_huge_free(sat_state->clauses.item, sat_state->clauses.size * sizeof(Clause));
+  sat_huge_free(sat_state->lit_arena.item, sat_state->lit_arena.size * sizeof(Lit*));
+  sat_huge_free(sat_state->occurrence_arena.item, sat_state->occurrence_arena.size * sizeof(Clause*));
 
   FREE_ARRAY(sat_state->decided_literals);
 
   for(Var* var = ARRAY_BEGIN(sat_state->vars); var < ARRAY_S_END(sat_state->vars); ++var)
     free_Var(var);
-  FREE_ARRAY(sat_state->vars);
+  sat_huge_free(sat_state->vars.item, sat_state->vars.size * sizeof(Var));
 
   FREE_ARRAY(sat_state->propagate_literals);
 
@@ -687,8 +854,8 @@ void pprint_SatState(SatState* sat_state, BOOLEAN print_clauses) {
     for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_S_END(sat_state->clauses); ++clause)
       pprint_Clause(clause, true);
     fprintf(stderr, "  Learned Clauses : \n");
-    for(ClauseListNode* cln = sat_state->learned_clauses.lh_first; cln != NULL; cln = cln->link.le_next)
-      pprint_Clause(cln->clause, true);
+    for(Clause** clause = ARRAY_BEGIN(sat_state->learned_clauses); clause < ARRAY_C_END(sat_state->learned_clauses); ++clause)
+      pprint_Clause(*clause, true);
     fprintf(stderr, "  Current Pending Propagations : \n");
     for(Lit** unit = ARRAY_BEGIN(sat_state->propagate_literals); unit < ARRAY_C_END(sat_state->propagate_literals); ++unit)
       pprint_Lit(*unit, false);
@@ -728,9 +895,18 @@ void pprint_SatState(SatState* sat_state, BOOLEAN print_clauses) {
 //applies unit resolution to the cnf of sat state
 //returns 1 if unit resolution succeeds, 0 if it finds a contradiction
 BOOLEAN sat_unit_resolution(SatState* sat_state) {
-  for(Lit** unit = ARRAY_BEGIN(sat_state->propagate_literals); unit < ARRAY_C_END(sat_state->propagate_literals); ++unit)
-    if(!propagate_lit_decision(*unit, sat_state))
-      return false;
+  c2dSize propagated = 0;
+  while(true) {
+    for(Lit** unit = ARRAY_BEGIN(sat_state->propagate_literals) + propagated; unit < ARRAY_C_END(sat_state->propagate_literals); ++unit)
+      if(!propagate_lit_decision(*unit, sat_state))
+        return false;
+
+    //XORs are propagated once clauses reach a fixpoint, and may imply more literals
+    propagated = sat_state->propagate_literals.count;
+    if(sat_state->xors == NULL) break;
+    if(!sat_propagate_xors(sat_state)) return false;
+    if(sat_state->propagate_literals.count == propagated) break;
+  }
 
   sat_state->propagate_literals.count = 0;
 
@@ -745,19 +921,22 @@ void sat_undo_unit_resolution(SatState* sat_state) {
   while(sat_state->decided_literals.count
     && (lit = *(ARRAY_C_END(sat_state->decided_literals) - 1))->var->decision.level == sat_state->level) {
     --sat_state->decided_literals.count;
+    lit->var->phase = lit->id > 0; //phase saving
     unset_Var_Decision(lit->var);
   }
 
-  ClauseListNode* cln;
-  while(cln = sat_state->subsumed_clauses.lh_first) {
-    Clause* clause = cln->clause;
-    LIST_REMOVE(cln, link);
-    free_CLN(cln);
+  while(sat_state->subsumed_clauses.count > 0) {
+    Clause* clause = sat_state->subsumed_clauses.item[--sat_state->subsumed_clauses.count];
     if(clause == NULL) break;
     clause->is_subsumed = false;
   }
 
+  if(sat_state->xors) sat_undo_xors(sat_state);
+
   sat_state->propagate_literals.count = 0;
+
+  //back to the initial state: unit clauses are decided again
+  if(sat_state->level == 1) decide_unit_clauses(sat_state);
 }
 
 //returns 1 if the decision level of the sat state equals to the assertion level of clause,
@@ -765,8 +944,21 @@ void sat_undo_unit_resolution(SatState* sat_state) {
 //
 //this function is called after sat_decide_literal() or sat_assert_clause() returns clause.
 //it is used to decide whether the sat state is at the right decision level for adding clause.
+//
+//chronological backtracking asserts a clause learned at level L at level L-1 instead. its implied
+//literal then gets level L-1 (not the assertion level), which keeps the decided literals sorted
+//by level: unit resolution, undoing levels and conflict analysis are unchanged, and a clause
+//learned later may only get a higher assertion level than needed. unit clauses are always
+//asserted at level 1, where they stay implied
 BOOLEAN sat_at_assertion_level(const Clause* clause, const SatState* sat_state) {
-  return clause->assertion_level == sat_state->level;
+  if(clause->assertion_level == sat_state->level) return true;
+  //the implied literal of clause is free from the level below the one where clause was learned
+  return sat_state->chronological && clause->assertion_level > 1 && !sat_instantiated_var(clause->lits.item[0]->var)
+      && sat_state->level - clause->assertion_level >= sat_state->chronological;
+}
+
+void sat_set_chronological_backtracking(c2dSize threshold, SatState* sat_state) {
+  sat_state->chronological = threshold;
 }
 
 
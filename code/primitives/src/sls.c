@@ -0,0 +1,185 @@
+#include <math.h>
+
+#include "sat_api.h"
+
+/******************************************************************************
+ * Stochastic local search (ProbSAT):
+ * --a complete assignment is repaired by flipping variables: each flip picks a
+ *   random falsified clause, and flips one of its variables with probability
+ *   proportional to f(break), where the break of a variable is the number of
+ *   clauses that become falsified by flipping it
+ * --f is polynomial, (eps + break)^-cb, for clauses of up to 3 literals, and
+ *   exponential, cb^-break, for longer ones (with the constants of Balint and
+ *   Schoening for random k-cnfs)
+ * --break counts are kept incrementally: each clause keeps the number of its true
+ *   literals and the xor of the indices of their variables, which is the index
+ *   of its critical variable when it has one true literal. a flip then only
+ *   visits the occurrences of the two literals of the flipped variable
+ *
+ * The search runs over the cnf clauses of the sat state (the literal and
+ * occurrence arenas), independently of its decisions: learned clauses are not
+ * needed (they are implied), and pushed XOR constraints are not searched.
+ * It starts from the saved phases of the variables, and saves the best
+ * assignment found (fewest falsified clauses) as their new phases, which a solver
+ * can use to pick the values of its decisions (rephasing).
+ ******************************************************************************/
+
+//break counts with precomputed probabilities (larger ones share the last)
+#define SLS_MAX_BREAK 64
+
+typedef struct {
+  BOOLEAN* values;                                  // values[i] is the value of the variable with index i
+  unsigned int* true_count;                         // per clause (by location in the clause array)
+  c2dSize* critical;                                // per clause, xor of the variables of its true literals
+  c2dSize* breaks;                                  // per variable index
+  c2dSize* falsified;                               // locations of falsified clauses
+  c2dSize* position;                                // position of a falsified clause in falsified
+  c2dSize falsified_count;
+  double poly[SLS_MAX_BREAK + 1];                   // f(break) for clauses of up to 3 literals
+  double exp[SLS_MAX_BREAK + 1];                    // f(break) for longer clauses
+  unsigned long long random;                        // xorshift state
+} Sls;
+
+static unsigned long long next_random(Sls* sls) {
+  sls->random ^= sls->random << 13;
+  sls->random ^= sls->random >> 7;
+  sls->random ^= sls->random << 17;
+  return sls->random;
+}
+
+//returns a random double in [0,1)
+static double uniform(Sls* sls) {
+  return (next_random(sls) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static c2dSize location(const Clause* clause, const SatState* sat_state) {
+  return clause - sat_state->clauses.item;
+}
+
+static BOOLEAN true_literal(const Lit* lit, const Sls* sls) {
+  return sls->values[lit->var->id] == (lit->id > 0);
+}
+
+static void falsify(c2dSize c, Sls* sls) {
+  sls->position[c] = sls->falsified_count;
+  sls->falsified[sls->falsified_count++] = c;
+}
+
+static void satisfy(c2dSize c, Sls* sls) {
+  c2dSize last = sls->falsified[--sls->falsified_count];
+  sls->falsified[sls->position[c]] = last;
+  sls->position[last] = sls->position[c];
+}
+
+//the true and false literals of var swap
+static void flip(Var* var, Sls* sls, const SatState* sat_state) {
+  c2dSize v = var->id;
+  Lit* made_true = var->lit + !sls->values[v];
+  Lit* made_false = var->lit + sls->values[v];
+  sls->values[v] = !sls->values[v];
+
+  for(Clause** clause = ARRAY_BEGIN(made_true->appears_in); clause < ARRAY_C_END(made_true->appears_in); ++clause) {
+    c2dSize c = location(*clause, sat_state);
+    if(++sls->true_count[c] == 1) {
+      satisfy(c, sls);
+      ++sls->breaks[v];
+    }
+    else if(sls->true_count[c] == 2) --sls->breaks[sls->critical[c]];
+    sls->critical[c] ^= v;
+  }
+
+  for(Clause** clause = ARRAY_BEGIN(made_false->appears_in); clause < ARRAY_C_END(made_false->appears_in); ++clause) {
+    c2dSize c = location(*clause, sat_state);
+    sls->critical[c] ^= v;
+    if(--sls->true_count[c] == 0) {
+      falsify(c, sls);
+      --sls->breaks[v];
+    }
+    else if(sls->true_count[c] == 1) ++sls->breaks[sls->critical[c]];
+  }
+}
+
+//returns the variable to flip in a falsified clause
+static Var* pick(const Clause* clause, Sls* sls) {
+  const double* f = clause->lits.count <= 3 ? sls->poly : sls->exp;
+  double probabilities[clause->lits.count];
+  double sum = 0;
+  for(c2dSize i = 0; i < clause->lits.count; ++i) {
+    c2dSize b = sls->breaks[clause->lits.item[i]->var->id];
+    sum += probabilities[i] = f[b < SLS_MAX_BREAK ? b : SLS_MAX_BREAK];
+  }
+
+  double r = uniform(sls) * sum;
+  for(c2dSize i = 0; i + 1 < clause->lits.count; ++i) {
+    if(r < probabilities[i]) return clause->lits.item[i]->var;
+    r -= probabilities[i];
+  }
+  return clause->lits.item[clause->lits.count - 1]->var;
+}
+
+static void save_phases(const Sls* sls, SatState* sat_state) {
+  for(Var* var = ARRAY_BEGIN(sat_state->vars); var < ARRAY_C_END(sat_state->vars); ++var)
+    var->phase = sls->values[var->id];
+}
+
+//searches for a model of the cnf clauses of sat state, making at most flips flips
+//returns 1 if a model is found (saved as the phases of variables), 0 otherwise (the best
+//assignment found is saved as the phases)
+BOOLEAN sat_local_search(c2dSize flips, unsigned long seed, SatState* sat_state) {
+  c2dSize var_count = sat_state->vars.count, clause_count = sat_state->clauses.count;
+  Sls sls;
+  sls.values = calloc(var_count + 1, sizeof(BOOLEAN));
+  sls.breaks = calloc(var_count + 1, sizeof(c2dSize));
+  sls.true_count = sat_huge_alloc(clause_count * sizeof(unsigned int));
+  sls.critical = sat_huge_alloc(clause_count * sizeof(c2dSize));
+  sls.falsified = sat_huge_alloc(clause_count * sizeof(c2dSize));
+  sls.position = sat_huge_alloc(clause_count * sizeof(c2dSize));
+  sls.falsified_count = 0;
+  sls.random = 0x9E3779B97F4A7C15ULL ^ seed;
+  for(int b = 0; b <= SLS_MAX_BREAK; ++b) {
+    sls.poly[b] = pow(1.0 + b, -2.38);
+    sls.exp[b] = pow(3.7, -b);
+  }
+
+  for(Var* var = ARRAY_BEGIN(sat_state->vars); var < ARRAY_C_END(sat_state->vars); ++var)
+    sls.values[var->id] = var->phase;
+  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_C_END(sat_state->clauses); ++clause) {
+    c2dSize c = location(clause, sat_state);
+    for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_C_END(clause->lits); ++lit) {
+      if(!true_literal(*lit, &sls)) continue;
+      ++sls.true_count[c];
+      sls.critical[c] ^= (*lit)->var->id;
+    }
+    if(sls.true_count[c] == 0) falsify(c, &sls);
+    else if(sls.true_count[c] == 1) ++sls.breaks[sls.critical[c]];
+  }
+
+  c2dSize best = sls.falsified_count;
+  save_phases(&sls, sat_state);
+  for(c2dSize i = 0; i < flips && sls.falsified_count > 0; ++i) {
+    Clause* clause = sat_state->clauses.item + sls.falsified[next_random(&sls) % sls.falsified_count];
+    if(clause->lits.count == 0) break; //the empty clause cannot be satisfied
+    flip(pick(clause, &sls), &sls, sat_state);
+    if(sls.falsified_count < best) {
+      best = sls.falsified_count;
+      save_phases(&sls, sat_state);
+    }
+  }
+
+  free(sls.values);
+  free(sls.breaks);
+  sat_huge_free(sls.true_count, clause_count * sizeof(unsigned int));
+  sat_huge_free(sls.critical, clause_count * sizeof(c2dSize));
+  sat_huge_free(sls.falsified, clause_count * sizeof(c2dSize));
+  sat_huge_free(sls.position, clause_count * sizeof(c2dSize));
+  return best == 0;
+}
+
+//returns the literal of a variable that agrees with its saved phase
+Lit* sat_phase_literal(const Var* var) {
+  return (((Var*) var)->lit) + var->phase;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
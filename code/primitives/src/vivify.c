@@ -0,0 +1,135 @@
+#include "sat_api.h"
+
+/******************************************************************************
+ * Vivification of learned clauses:
+ * --a learned clause is shortened by deciding the negations of its literals one
+ *   at a time (each at a new level), while unit resolution ignores the clause:
+ *   --a literal found false is implied false by the earlier ones: it is dropped
+ *   --a literal found true is implied by the earlier ones: the clause ends with it
+ *   --a contradiction means the earlier literals, with the current one, already
+ *     form an implied clause: the clause ends with the current literal
+ * --clauses are visited from the most recently learned (the ones search uses
+ *   now), skipping binary clauses and clauses vivified before, until the
+ *   literals implied by the decisions exceed the propagation budget
+ * --a shortened clause keeps its place and index: it leaves the learned clauses
+ *   of its dropped literals, and is watched again by its first two literals
+ *
+ * This runs at level 1, where a learned clause is either subsumed or has no
+ * false literal after its literals false at level 1 are dropped, so its first
+ * two literals are free and can be watched.
+ ******************************************************************************/
+
+void watch_clause(Lit*, Clause*);
+
+//removes clause from an array of clauses (whose order does not matter)
+static void unlink_clause(const Clause* clause, ClauseArray* clauses) {
+  for(Clause** c = ARRAY_BEGIN(*clauses); c < ARRAY_C_END(*clauses); ++c) {
+    if(*c != clause) continue;
+    *c = clauses->item[--clauses->count];
+    return;
+  }
+}
+
+//returns 1 if a literal of clause is implied at level 1
+static BOOLEAN satisfied_clause(const Clause* clause) {
+  for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_S_END(clause->lits); ++lit)
+    if(sat_implied_literal(*lit)) return true;
+  return false;
+}
+
+//finds the literals of clause to keep (at the beginning of kept), using at most budget propagations
+//returns the number of kept literals, and decrements budget by the propagations made
+static c2dSize vivify(Clause* clause, Lit** kept, c2dSize* budget, SatState* sat_state) {
+  c2dSize count = 0, levels = 0;
+
+  for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_S_END(clause->lits); ++lit) {
+    if(sat_instantiated_var((*lit)->var)) {
+      if(sat_implied_literal(*lit)) { //implied by the negations of the kept literals
+        kept[count++] = *lit;
+        break;
+      }
+      continue; //false: redundant
+    }
+    kept[count++] = *lit;
+    if(*budget == 0) continue; //out of propagations: the remaining literals are kept
+
+    c2dSize trail = sat_trail_size(sat_state);
+    Clause* learned = sat_decide_literal((*lit)->var->lit + ((*lit)->id < 0), sat_state); //negation of lit
+    ++levels;
+    c2dSize implied = sat_trail_size(sat_state) - trail;
+    *budget = implied < *budget ? *budget - implied : 0;
+
+    if(learned != NULL) { //the kept literals form an implied clause
+      sat_discard_clause(learned);
+      break;
+    }
+  }
+
+  while(levels-- > 0) sat_undo_decide_literal(sat_state);
+  return count;
+}
+
+//replaces the literals of clause by the first count of kept, and watches it again
+//(in the watches of its new size class)
+static void shorten(Clause* clause, Lit** kept, c2dSize count) {
+  c2dSize size_class = WATCH_CLASS(clause->lits.size);
+  unlink_clause(clause, clause->watch_a->watches + size_class);
+  unlink_clause(clause, clause->watch_b->watches + size_class);
+
+  for(Lit** lit = ARRAY_BEGIN(clause->lits); lit < ARRAY_S_END(clause->lits); ++lit) {
+    BOOLEAN dropped = true;
+    for(c2dSize k = 0; k < count && dropped; ++k) dropped = kept[k] != *lit;
+    if(dropped) unlink_clause(clause, &((*lit)->learned_in));
+  }
+
+  memcpy(clause->lits.item, kept, count * sizeof(Lit*));
+  clause->lits.size = clause->lits.count = count;
+
+  clause->watch_a = clause->lits.item[0];
+  clause->watch_b = clause->lits.item[1];
+  clause->search = 0;
+  watch_clause(clause->watch_a, clause);
+  watch_clause(clause->watch_b, clause);
+}
+
+//shortens learned clauses that were not vivified before (most recent first), until the
+//literals implied by vivification exceed budget
+//returns the number of literals removed from learned clauses
+c2dSize sat_vivify_learned_clauses(c2dSize budget, SatState* sat_state) {
+  c2dSize removed = 0;
+  Lit** kept = NULL;
+  c2dSize kept_size = 0;
+
+  for(c2dSize k = sat_state->learned_clauses.count; k > 0 && budget > 0; --k) {
+    Clause* clause = sat_state->learned_clauses.item[k - 1];
+    if(clause->vivified || clause->lits.count <= 2 || sat_subsumed_clause(clause) || satisfied_clause(clause)) continue;
+    clause->vivified = true;
+
+    if(kept_size < clause->lits.count) {
+      kept_size = clause->lits.count;
+      kept = realloc(kept, kept_size * sizeof(Lit*));
+    }
+
+    //ignored by unit resolution (outside of the subsumed list, which is undone by levels)
+    clause->is_subsumed = true;
+    c2dSize count = vivify(clause, kept, &budget, sat_state);
+    clause->is_subsumed = false;
+
+    if(count < 2) { //a unit would have to be asserted: a free dropped literal is kept with it
+      for(Lit** lit = ARRAY_BEGIN(clause->lits); count < 2 && lit < ARRAY_S_END(clause->lits); ++lit)
+        if(!sat_instantiated_var((*lit)->var) && (count == 0 || *lit != kept[0])) kept[count++] = *lit;
+      if(count < 2) continue;
+    }
+    if(count == clause->lits.count) continue;
+
+    removed += clause->lits.count - count;
+    shorten(clause, kept, count);
+  }
+
+  free(kept);
+  return removed;
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
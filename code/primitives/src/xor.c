@@ -0,0 +1,403 @@
+#include "sat_api.h"
+
+/******************************************************************************
+ * XOR constraints:
+ * --an XOR over k variables is encoded in a cnf by the 2^(k-1) clauses over these
+ *   variables that exclude the assignments of the wrong parity
+ * --such clause sets are recovered when the cnf is loaded, and their XORs become
+ *   the rows of a bit matrix (see XorMatrix in sat_api.h)
+ * --unit resolution on the encoding clauses only finds what each XOR implies on
+ *   its own, while the matrix finds what their sums imply (which is exponentially
+ *   cheaper on parity chains)
+ * --XORs can also be pushed (and popped) before unit resolution, such as the random
+ *   hashes of approximate model counting: the matrix is then rebuilt from all XORs
+ *
+ * Propagation keeps every row in reduced form w.r.t. the unassigned columns: when
+ * the pivot of a row is assigned, another unassigned column of the row becomes
+ * its pivot, and is eliminated from all other rows. As pivots are then distinct
+ * unassigned columns, a row with one unassigned column is an implication, a row
+ * with none is either satisfied or a contradiction, and no sum of rows implies
+ * more. Row operations are never undone: the rows stay equivalent to the
+ * XORs, so backtracking only frees reason clauses.
+ ******************************************************************************/
+
+//XORs of more variables are not recovered
+#define XOR_MAX_SIZE 6
+
+#define WORD_BITS (8 * sizeof(unsigned long))
+#define ROW(matrix, r) ((matrix)->bits + (r) * (matrix)->words)
+#define HAS_COL(bits, c) (((bits)[(c) / WORD_BITS] >> ((c) % WORD_BITS)) & 1)
+#define SET_COL(bits, c) ((bits)[(c) / WORD_BITS] |= 1UL << ((c) % WORD_BITS))
+#define CLEAR_COL(bits, c) ((bits)[(c) / WORD_BITS] &= ~(1UL << ((c) % WORD_BITS)))
+
+BOOLEAN set_Lit_Decision(Lit*, Clause*, SatState*);
+BOOLEAN sat_contradiction(Clause*, SatState*);
+void init_Clause(Clause*, c2dSize, c2dSize);
+void free_Clause(Clause*);
+
+/******************************************************************************
+ * Recovering XORs
+ ******************************************************************************/
+
+//a clause that may be part of an XOR encoding
+typedef struct {
+  c2dSize size;
+  c2dSize vars[XOR_MAX_SIZE];                       // sorted variable indices
+  unsigned int signs;                               // bit i is set if the literal of vars[i] is negative
+} XorCandidate;
+
+static int compare_candidates(const void* a, const void* b) {
+  const XorCandidate* x = (const XorCandidate*) a;
+  const XorCandidate* y = (const XorCandidate*) b;
+  if(x->size != y->size) return x->size < y->size ? -1 : 1;
+  for(c2dSize i = 0; i < x->size; ++i)
+    if(x->vars[i] != y->vars[i]) return x->vars[i] < y->vars[i] ? -1 : 1;
+  return 0;
+}
+
+//returns false if the clause cannot be part of an XOR encoding
+static BOOLEAN init_candidate(XorCandidate* candidate, const Clause* clause) {
+  c2dSize size = clause->lits.count;
+  if(size < 2 || size > XOR_MAX_SIZE) return false;
+
+  Lit* lits[XOR_MAX_SIZE];
+  for(c2dSize i = 0; i < size; ++i) {
+    Lit* lit = clause->lits.item[i];
+    c2dSize j = i;
+    for(; j > 0 && lits[j - 1]->var->id > lit->var->id; --j)
+      lits[j] = lits[j - 1];
+    if(j > 0 && lits[j - 1]->var == lit->var) return false; //repeated variable
+    lits[j] = lit;
+  }
+
+  candidate->size = size;
+  candidate->signs = 0;
+  for(c2dSize i = 0; i < size; ++i) {
+    candidate->vars[i] = lits[i]->var->id;
+    if(lits[i]->id < 0) candidate->signs |= 1U << i;
+  }
+  return true;
+}
+
+static XorMatrix* new_matrix(const SatState* sat_state) {
+  XorMatrix* matrix = malloc(sizeof(XorMatrix));
+  INIT_ARRAY(matrix->constraint_vars, c2dSize, 4 * XOR_MAX_SIZE);
+  INIT_ARRAY(matrix->constraint_parity, BOOLEAN, 4);
+  matrix->recovered = 0;
+  matrix->rows = matrix->cols = matrix->words = 0;
+  matrix->vars = NULL;
+  matrix->bits = NULL;
+  matrix->parity = NULL;
+  matrix->pivot = NULL;
+  matrix->free_cols = NULL;
+  matrix->true_cols = NULL;
+  INIT_ARRAY(matrix->reasons, Clause*, sat_state->vars.count + 1);
+  return matrix;
+}
+
+//frees the rows of matrix (but not its constraints)
+static void free_rows(XorMatrix* matrix) {
+  free(matrix->vars);
+  free(matrix->bits);
+  free(matrix->parity);
+  free(matrix->pivot);
+  free(matrix->free_cols);
+  free(matrix->true_cols);
+}
+
+static void free_matrix(XorMatrix* matrix) {
+  for(Clause** reason = ARRAY_BEGIN(matrix->reasons); reason < ARRAY_C_END(matrix->reasons); ++reason) {
+    free_Clause(*reason);
+    free(*reason);
+  }
+  FREE_ARRAY(matrix->reasons);
+  FREE_ARRAY(matrix->constraint_vars);
+  FREE_ARRAY(matrix->constraint_parity);
+  free_rows(matrix);
+  free(matrix);
+}
+
+void sat_xors_free(SatState* sat_state) {
+  if(sat_state->xors) free_matrix(sat_state->xors);
+  sat_state->xors = NULL;
+}
+
+//brings the rows of matrix to reduced row echelon form, dropping rows that become empty
+//(unless their parity is odd, in which case the XORs are inconsistent)
+static void eliminate(XorMatrix* matrix) {
+  c2dSize rank = 0;
+  for(c2dSize c = 0; c < matrix->cols && rank < matrix->rows; ++c) {
+    c2dSize r = rank;
+    while(r < matrix->rows && !HAS_COL(ROW(matrix, r), c)) ++r;
+    if(r == matrix->rows) continue;
+
+    if(r != rank) { //swap rows
+      for(c2dSize w = 0; w < matrix->words; ++w) {
+        unsigned long word = ROW(matrix, r)[w];
+        ROW(matrix, r)[w] = ROW(matrix, rank)[w];
+        ROW(matrix, rank)[w] = word;
+      }
+      BOOLEAN parity = matrix->parity[r];
+      matrix->parity[r] = matrix->parity[rank];
+      matrix->parity[rank] = parity;
+    }
+    for(c2dSize j = 0; j < matrix->rows; ++j) {
+      if(j == rank || !HAS_COL(ROW(matrix, j), c)) continue;
+      for(c2dSize w = 0; w < matrix->words; ++w) ROW(matrix, j)[w] ^= ROW(matrix, rank)[w];
+      matrix->parity[j] ^= matrix->parity[rank];
+    }
+    matrix->pivot[rank++] = c;
+  }
+
+  //rows from rank on are empty: keep one if it is a contradiction
+  for(c2dSize r = rank; r < matrix->rows; ++r) {
+    if(!matrix->parity[r]) continue;
+    memset(ROW(matrix, rank), 0, matrix->words * sizeof(unsigned long));
+    matrix->parity[rank] = true;
+    matrix->pivot[rank++] = matrix->cols;
+    break;
+  }
+  matrix->rows = rank;
+}
+
+//appends an XOR constraint to the constraints of matrix
+static void add_constraint(XorMatrix* matrix, const c2dSize* vars, c2dSize size, BOOLEAN parity) {
+  if(matrix->constraint_vars.count + size + 1 > matrix->constraint_vars.size) {
+    matrix->constraint_vars.size = 2 * (matrix->constraint_vars.count + size + 1);
+    matrix->constraint_vars.item = realloc(matrix->constraint_vars.item, matrix->constraint_vars.size * sizeof(c2dSize));
+  }
+  for(c2dSize k = 0; k < size; ++k) matrix->constraint_vars.item[matrix->constraint_vars.count++] = vars[k];
+  matrix->constraint_vars.item[matrix->constraint_vars.count++] = 0;
+
+  if(matrix->constraint_parity.count == matrix->constraint_parity.size) {
+    matrix->constraint_parity.size *= 2;
+    matrix->constraint_parity.item = realloc(matrix->constraint_parity.item, matrix->constraint_parity.size * sizeof(BOOLEAN));
+  }
+  matrix->constraint_parity.item[matrix->constraint_parity.count++] = parity;
+}
+
+//rebuilds the rows of the XOR matrix of sat state from its constraints, with one column
+//for each variable they mention
+//
+//reason clauses are kept: they are implied by the constraints that remain
+static void build_matrix(SatState* sat_state) {
+  XorMatrix* matrix = sat_state->xors;
+  free_rows(matrix);
+
+  c2dSize* cols = calloc(sat_state->vars.count + 1, sizeof(c2dSize)); //1 + column of each variable (0 if none)
+  c2dSize col_count = 0;
+  for(c2dSize* v = ARRAY_BEGIN(matrix->constraint_vars); v < ARRAY_C_END(matrix->constraint_vars); ++v)
+    if(*v && cols[*v] == 0) cols[*v] = ++col_count;
+
+  c2dSize row_count = matrix->constraint_parity.count;
+  matrix->rows = row_count;
+  matrix->cols = col_count;
+  matrix->words = (col_count + WORD_BITS - 1) / WORD_BITS;
+  matrix->vars = malloc(col_count * sizeof(Var*));
+  matrix->bits = calloc(row_count * matrix->words, sizeof(unsigned long));
+  matrix->parity = malloc(row_count * sizeof(BOOLEAN));
+  matrix->pivot = malloc(row_count * sizeof(c2dSize));
+  matrix->free_cols = malloc(matrix->words * sizeof(unsigned long));
+  matrix->true_cols = malloc(matrix->words * sizeof(unsigned long));
+
+  for(c2dSize v = 1; v <= sat_state->vars.count; ++v)
+    if(cols[v]) matrix->vars[cols[v] - 1] = sat_state->vars.item + v - 1;
+  c2dSize* v = ARRAY_BEGIN(matrix->constraint_vars);
+  for(c2dSize r = 0; r < row_count; ++r, ++v) {
+    for(; *v; ++v) ROW(matrix, r)[(cols[*v] - 1) / WORD_BITS] ^= 1UL << ((cols[*v] - 1) % WORD_BITS); //repeated variables cancel
+    matrix->parity[r] = matrix->constraint_parity.item[r];
+  }
+  free(cols);
+  eliminate(matrix);
+}
+
+//recovers XOR constraints from their encodings in the cnf of sat state (all clauses
+//over the same variables that exclude the assignments of one parity), which are then
+//propagated by Gauss-Jordan elimination along with unit resolution
+//returns the number of XOR constraints recovered
+//
+//this can only be called before any literal is decided and before any clause is learned
+c2dSize sat_recover_xors(SatState* sat_state) {
+  assert(sat_state->level == 1 && sat_state->learned_clauses.count == 0 && sat_state->xors == NULL);
+
+  XorCandidate* candidates = malloc(sat_state->clauses.count * sizeof(XorCandidate));
+  c2dSize candidate_count = 0;
+  for(Clause* clause = ARRAY_BEGIN(sat_state->clauses); clause < ARRAY_C_END(sat_state->clauses); ++clause)
+    if(init_candidate(candidates + candidate_count, clause)) ++candidate_count;
+  qsort(candidates, candidate_count, sizeof(XorCandidate), compare_candidates);
+
+  //groups of candidates over the same variables: the group encodes an XOR if it excludes all
+  //assignments of one parity (a clause excludes the assignment falsifying its literals, whose
+  //parity is the parity of its negative literals)
+  XorCandidate* xors = malloc((candidate_count + 1) * sizeof(XorCandidate));
+  c2dSize xor_count = 0;
+  for(c2dSize i = 0, j; i < candidate_count; i = j) {
+    unsigned long excluded[2] = {0, 0}; //excluded sign patterns, by parity
+    for(j = i; j < candidate_count && compare_candidates(candidates + i, candidates + j) == 0; ++j)
+      excluded[__builtin_popcount(candidates[j].signs) & 1] |= 1UL << candidates[j].signs;
+
+    c2dSize size = candidates[i].size;
+    for(int parity = 0; parity < 2; ++parity) {
+      if((c2dSize) __builtin_popcountl(excluded[parity]) != (1UL << (size - 1))) continue;
+      xors[xor_count] = candidates[i];
+      xors[xor_count].signs = !parity; //the excluded assignments have this parity, so the XOR has the other
+      ++xor_count;
+    }
+  }
+  free(candidates);
+
+  if(xor_count > 0) {
+    XorMatrix* matrix = new_matrix(sat_state);
+    for(c2dSize r = 0; r < xor_count; ++r) add_constraint(matrix, xors[r].vars, xors[r].size, xors[r].signs);
+    matrix->recovered = xor_count;
+    sat_state->xors = matrix;
+    build_matrix(sat_state);
+  }
+
+  free(xors);
+  return xor_count;
+}
+
+//adds an XOR constraint over variables (given by their indices), which holds when the number
+//of true variables has the given parity (1 for odd)
+//
+//this can only be called before unit resolution (or after it is undone)
+void sat_push_xor(const c2dSize* vars, c2dSize size, BOOLEAN parity, SatState* sat_state) {
+  assert(sat_state->level == 1);
+  if(sat_state->xors == NULL) sat_state->xors = new_matrix(sat_state);
+  add_constraint(sat_state->xors, vars, size, parity);
+  build_matrix(sat_state);
+}
+
+//removes the last XOR constraint added by sat_push_xor()
+//
+//this can only be called before unit resolution (or after it is undone), and no clause learned
+//since the constraint was added should have been asserted (as it may depend on the constraint)
+void sat_pop_xor(SatState* sat_state) {
+  XorMatrix* matrix = sat_state->xors;
+  assert(sat_state->level == 1 && matrix && matrix->constraint_parity.count > matrix->recovered);
+  --matrix->constraint_parity.count;
+  --matrix->constraint_vars.count; //the 0 ending the constraint
+  while(matrix->constraint_vars.count && matrix->constraint_vars.item[matrix->constraint_vars.count - 1])
+    --matrix->constraint_vars.count;
+  build_matrix(sat_state);
+}
+
+//returns the rank of the XOR constraints over the unassigned variables (so the unassigned
+//variables have 2^(count-rank) assignments satisfying the XOR constraints)
+//
+//this is called after unit resolution succeeds: propagation then leaves every row with an
+//unassigned variable with a distinct unassigned pivot
+c2dSize sat_xor_rank(const SatState* sat_state) {
+  const XorMatrix* matrix = sat_state->xors;
+  if(matrix == NULL) return 0;
+  c2dSize rank = 0;
+  for(c2dSize r = 0; r < matrix->rows; ++r)
+    if(matrix->pivot[r] < matrix->cols && !sat_instantiated_var(matrix->vars[matrix->pivot[r]])) ++rank;
+  return rank;
+}
+
+/******************************************************************************
+ * Propagating XORs
+ ******************************************************************************/
+
+//returns a reason clause for row r of matrix: lit (if not NULL) and the falsified literals of
+//the other variables of the row
+static Clause* xor_reason(XorMatrix* matrix, c2dSize r, Lit* lit, SatState* sat_state) {
+  unsigned long* row = ROW(matrix, r);
+  c2dSize size = 0;
+  for(c2dSize w = 0; w < matrix->words; ++w) size += __builtin_popcountl(row[w]);
+
+  Clause* reason = malloc(sizeof(Clause));
+  init_Clause(reason, 0, size);
+  reason->assertion_level = sat_state->level; //reasons are not learned: this is the level they belong to
+  if(lit) reason->lits.item[reason->lits.count++] = lit;
+  for(c2dSize w = 0; w < matrix->words; ++w) {
+    for(unsigned long bits = row[w]; bits; bits &= bits - 1) {
+      Var* var = matrix->vars[w * WORD_BITS + __builtin_ctzl(bits)];
+      if(lit && var == lit->var) continue;
+      reason->lits.item[reason->lits.count++] = var->lit + !var->decision.value;
+    }
+  }
+
+  if(matrix->reasons.count == matrix->reasons.size) {
+    matrix->reasons.size *= 2;
+    matrix->reasons.item = realloc(matrix->reasons.item, matrix->reasons.size * sizeof(Clause*));
+  }
+  matrix->reasons.item[matrix->reasons.count++] = reason;
+  return reason;
+}
+
+//makes column c the pivot of row r, eliminating it from all other rows
+static void xor_repivot(XorMatrix* matrix, c2dSize r, c2dSize c) {
+  unsigned long* row = ROW(matrix, r);
+  for(c2dSize j = 0; j < matrix->rows; ++j) {
+    if(j == r || !HAS_COL(ROW(matrix, j), c)) continue;
+    for(c2dSize w = 0; w < matrix->words; ++w) ROW(matrix, j)[w] ^= row[w];
+    matrix->parity[j] ^= matrix->parity[r];
+  }
+  matrix->pivot[r] = c;
+}
+
+//propagates the XORs of sat state under its current setting
+//implied literals are added to the literals to be propagated by unit resolution
+//returns false if a contradiction is found, true otherwise
+BOOLEAN sat_propagate_xors(SatState* sat_state) {
+  XorMatrix* matrix = sat_state->xors;
+
+  memset(matrix->free_cols, 0, matrix->words * sizeof(unsigned long));
+  memset(matrix->true_cols, 0, matrix->words * sizeof(unsigned long));
+  for(c2dSize c = 0; c < matrix->cols; ++c) {
+    Var* var = matrix->vars[c];
+    if(!sat_instantiated_var(var)) SET_COL(matrix->free_cols, c);
+    else if(var->decision.value) SET_COL(matrix->true_cols, c);
+  }
+
+  BOOLEAN changed = true;
+  while(changed) {
+    changed = false;
+    for(c2dSize r = 0; r < matrix->rows; ++r) {
+      unsigned long* row = ROW(matrix, r);
+      c2dSize free_count = 0, first = matrix->cols;
+      BOOLEAN parity = matrix->parity[r]; //parity of the unassigned columns of the row
+      for(c2dSize w = 0; w < matrix->words; ++w) {
+        unsigned long free_bits = row[w] & matrix->free_cols[w];
+        if(free_bits) {
+          if(free_count == 0) first = w * WORD_BITS + __builtin_ctzl(free_bits);
+          free_count += __builtin_popcountl(free_bits);
+        }
+        parity ^= __builtin_popcountl(row[w] & matrix->true_cols[w]) & 1;
+      }
+
+      if(free_count == 0) {
+        if(parity) return sat_contradiction(xor_reason(matrix, r, NULL, sat_state), sat_state);
+      } else if(free_count == 1) {
+        Var* var = matrix->vars[first];
+        Lit* lit = var->lit + (parity ? 1 : 0);
+        set_Lit_Decision(lit, xor_reason(matrix, r, lit, sat_state), sat_state);
+        sat_state->propagate_literals.item[sat_state->propagate_literals.count++] = lit;
+        CLEAR_COL(matrix->free_cols, first);
+        if(parity) SET_COL(matrix->true_cols, first);
+        changed = true;
+      } else if(matrix->pivot[r] == matrix->cols || !HAS_COL(matrix->free_cols, matrix->pivot[r])) {
+        xor_repivot(matrix, r, first);
+        changed = true;
+      }
+    }
+  }
+  return true;
+}
+
+//frees the reason clauses of the current decision level
+void sat_undo_xors(SatState* sat_state) {
+  XorMatrix* matrix = sat_state->xors;
+  while(matrix->reasons.count && matrix->reasons.item[matrix->reasons.count - 1]->assertion_level >= sat_state->level) {
+    Clause* reason = matrix->reasons.item[--matrix->reasons.count];
+    free_Clause(reason);
+    free(reason);
+  }
+}
+
+/******************************************************************************
+ * end
+ ******************************************************************************/
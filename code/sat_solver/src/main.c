@@ -4,59 +4,269 @@
  * SAT solver
  ******************************************************************************/
 
-//returns a literal which is free in the current setting of sat state
-//a NAIVE implementation no one would use in practice
-//you are free to modify this (no need though)
-Lit* get_free_literal(SatState* sat_state) {
-  c2dSize var_count = sat_var_count(sat_state);
-  for(c2dSize i=0; i<var_count; i++) { //go over variables
-    Var* var  = sat_index2var(i+1,sat_state); //note index is i+1, not i
-    if(!sat_instantiated_var(var)) return sat_pos_literal(var);
+/******************************************************************************
+ * Decisions:
+ * --free variables are kept in a heap ordered by activity (VSIDS): the variables of
+ *   each learned clause are bumped, and bumps grow geometrically so that recent
+ *   conflicts weigh more (ties go to lower indices, as in the input order)
+ * --a decided variable takes its saved phase: the value it had when last undone
+ *   (or the value found by local search, or positive)
+ * --variables leave the heap lazily, when they are found instantiated on top of
+ *   it, and come back when the level that instantiated them is undone
+ ******************************************************************************/
+
+#define ACTIVITY_DECAY 0.95
+#define ACTIVITY_LIMIT 1e100
+#define VIVIFY_CONFLICTS 2000
+#define SLS_RESTARTS 16
+#define SLS_BURST 10
+
+static c2dSize var_count;
+static double* activity;      //activity[i] is the activity of the variable with index i
+static double bump = 1;
+static c2dSize* heap;         //indices of variables
+static c2dSize* heap_position; //heap_position[i] is the position of variable i in heap (not below heap_size if none)
+static c2dSize heap_size;
+
+static BOOLEAN ranks_above(c2dSize i, c2dSize j) {
+  return activity[i] > activity[j] || (activity[i] == activity[j] && i < j);
+}
+
+static void heap_place(c2dSize i, c2dSize position) {
+  heap[position] = i;
+  heap_position[i] = position;
+}
+
+static void heap_up(c2dSize position) {
+  c2dSize i = heap[position];
+  while(position > 0 && ranks_above(i,heap[(position-1)/2])) {
+    heap_place(heap[(position-1)/2],position);
+    position = (position-1)/2;
+  }
+  heap_place(i,position);
+}
+
+static void heap_down(c2dSize position) {
+  c2dSize i = heap[position];
+  while(2*position+1 < heap_size) {
+    c2dSize child = 2*position+1;
+    if(child+1 < heap_size && ranks_above(heap[child+1],heap[child])) ++child;
+    if(!ranks_above(heap[child],i)) break;
+    heap_place(heap[child],position);
+    position = child;
+  }
+  heap_place(i,position);
+}
+
+static void heap_insert(c2dSize i) {
+  if(heap_position[i] < heap_size) return;
+  heap_place(i,heap_size++);
+  heap_up(heap_size-1);
+}
+
+static c2dSize heap_pop() {
+  c2dSize top = heap[0];
+  heap_position[top] = (c2dSize) -1;
+  if(--heap_size > 0) {
+    heap_place(heap[heap_size],0);
+    heap_down(0);
+  }
+  return top;
+}
+
+static void init_decisions(SatState* sat_state) {
+  var_count     = sat_var_count(sat_state);
+  activity      = calloc(var_count+1,sizeof(double));
+  heap          = malloc(var_count*sizeof(c2dSize));
+  heap_position = malloc((var_count+1)*sizeof(c2dSize));
+  for(c2dSize i=1; i<=var_count; i++) heap_place(i,i-1); //all activities are 0: sorted by index
+  heap_size = var_count;
+}
+
+static void free_decisions() {
+  free(activity);
+  free(heap);
+  free(heap_position);
+}
+
+//bumps the variables of a learned clause
+static void bump_clause(Clause* clause) {
+  Lit** lits = sat_clause_literals(clause);
+  for(c2dSize k=0; k<sat_clause_size(clause); k++) {
+    c2dSize i = sat_var_index(sat_literal_var(lits[k]));
+    if((activity[i] += bump) > ACTIVITY_LIMIT) { //rescale (keeps the order)
+      for(c2dSize j=1; j<=var_count; j++) activity[j] /= ACTIVITY_LIMIT;
+      bump /= ACTIVITY_LIMIT;
+    }
+    if(heap_position[i] < heap_size) heap_up(heap_position[i]);
   }
-  return NULL; //all literals are implied
+  bump /= ACTIVITY_DECAY;
 }
 
-//if sat state is shown to be satisfiable, it returns NULL
-//otherwise, a clause must be learned and it is returned
-Clause* sat_aux(SatState* sat_state) {
-  Lit* lit = get_free_literal(sat_state);
-  if(lit == NULL) return NULL; //all literals are implied
+//returns the index of the free variable with the highest activity (0 if all are instantiated)
+static c2dSize next_free_var(SatState* sat_state) {
+  while(heap_size > 0 && sat_instantiated_var(sat_index2var(heap[0],sat_state))) heap_pop();
+  return heap_size > 0 ? heap[0] : 0;
+}
+
+/******************************************************************************
+ * Search:
+ * --decisions are kept on a stack, with the size of the trail before each of them,
+ *   so that undoing a level puts the variables it instantiated back on the heap
+ *   (and saves their phases, see sat_undo_decide_literal)
+ * --restarts follow the Luby sequence (in units of restart conflicts)
+ * --with local search, every SLS_RESTARTS restarts run a burst of flips/SLS_BURST
+ *   flips from the saved phases, whose best assignment becomes the saved phases
+ *   (rephasing): decisions after the restart then follow it
+ * --a restart keeps the longest prefix of decisions whose variables still rank above
+ *   the variable that would be decided next: search would decide them again (with
+ *   their saved phases), so the trail they imply is reused instead of recomputed
+ * --every VIVIFY_CONFLICTS conflicts, search goes back to level 1 and vivifies the
+ *   learned clauses (within a budget of implied literals, see vivify.c)
+ * --learned clauses are deleted at level 1 too, keeping the most recent half (and the
+ *   short ones, see sat_compact_learned_clauses), after delete conflicts, then after
+ *   2*delete more conflicts, and so on
+ ******************************************************************************/
 
-  Clause* learned = sat_decide_literal(lit,sat_state);
-  if(learned == NULL) learned = sat_aux(sat_state);
+static Var** decisions;     //decisions[d] is the variable decided at level d+2
+static c2dSize* trail_start; //trail_start[d] is the trail size before decisions[d]
+static c2dSize depth;       //number of decisions
+
+static void undo_decision(SatState* sat_state) {
+  --depth;
+  for(c2dSize k=trail_start[depth]; k<sat_trail_size(sat_state); k++) {
+    Lit* lit = sat_trail_literal(k,sat_state);
+    if(sat_literal_index(lit)!=0) heap_insert(sat_var_index(sat_literal_var(lit))); //not the contradiction
+  }
   sat_undo_decide_literal(sat_state);
+}
+
+//returns the i^th element (from 0) of the Luby sequence: 1 1 2 1 1 2 4 1 1 2 ...
+static c2dSize luby(c2dSize i) {
+  c2dSize size = 1, power = 0;
+  while(size < i+1) {
+    size = 2*size+1;
+    ++power;
+  }
+  while(size-1 != i) {
+    size = (size-1)/2;
+    --power;
+    i %= size;
+  }
+  return ((c2dSize) 1) << power;
+}
+
+//undoes the decisions that would not be decided again before the next free variable
+static void restart(SatState* sat_state) {
+  c2dSize next = next_free_var(sat_state);
+  if(next==0) return; //all variables are instantiated
+  c2dSize kept = 0;
+  while(kept < depth && ranks_above(sat_var_index(decisions[kept]),next)) ++kept;
+  while(depth > kept) undo_decision(sat_state);
+}
 
-  if(learned != NULL) { //there is a conflict
-    if(sat_at_assertion_level(learned,sat_state)) {
+//returns 1 if sat state (after unit resolution) is satisfiable, 0 otherwise
+static BOOLEAN search(c2dSize restart_unit, c2dSize flips, c2dSize vivify_budget, c2dSize delete, SatState* sat_state) {
+  c2dSize conflicts = 0, restarts = 0, rounds = 0, deletions = 0;
+  c2dSize restart_limit = restart_unit, vivify_limit = VIVIFY_CONFLICTS, delete_limit = delete;
+
+  while(1) {
+    c2dSize i = next_free_var(sat_state);
+    if(i==0) return 1; //all literals are implied
+    Var* var = sat_index2var(i,sat_state);
+    trail_start[depth] = sat_trail_size(sat_state);
+    decisions[depth++] = var;
+
+    Clause* learned = sat_decide_literal(sat_phase_literal(var),sat_state);
+    while(learned != NULL) { //there is a conflict
+      bump_clause(learned);
+      ++conflicts;
+      while(depth > 0 && !sat_at_assertion_level(learned,sat_state)) undo_decision(sat_state);
+      if(!sat_at_assertion_level(learned,sat_state)) return 0; //contradiction without decisions
       learned = sat_assert_clause(learned,sat_state);
-      if(learned == NULL) return sat_aux(sat_state); //try again
-      else return learned; //new clause learned, backtrack
     }
-    else return learned; //backtrack (still conflict)
+
+    if(restart_unit > 0 && conflicts >= restart_limit) {
+      restart(sat_state);
+      restart_limit = conflicts + restart_unit*luby(++restarts);
+      if(flips >= SLS_BURST && restarts % SLS_RESTARTS == 0) sat_local_search(flips/SLS_BURST,restarts,sat_state);
+    }
+
+    if(vivify_budget > 0 && conflicts >= vivify_limit) {
+      while(depth > 0) undo_decision(sat_state);
+      c2dSize removed = sat_vivify_learned_clauses(vivify_budget,sat_state);
+      printf("c vivification round %lu: %lu literals removed\n",++rounds,removed);
+      vivify_limit = conflicts + VIVIFY_CONFLICTS;
+    }
+
+    if(delete > 0 && conflicts >= delete_limit) {
+      while(depth > 0) undo_decision(sat_state);
+      c2dSize deleted = sat_compact_learned_clauses(sat_learned_clause_count(sat_state)/2,sat_state);
+      printf("c deletion round %lu: %lu learned clauses deleted\n",++deletions,deleted);
+      delete_limit = conflicts + delete*(deletions+1);
+    }
   }
-  return NULL; //satisfiable
 }
 
-BOOLEAN sat(SatState* sat_state) {
+BOOLEAN sat(c2dSize restart_unit, c2dSize flips, c2dSize vivify_budget, c2dSize delete, SatState* sat_state) {
   BOOLEAN ret = 0;
-  if(sat_unit_resolution(sat_state)) ret = (sat_aux(sat_state) == NULL);
+  init_decisions(sat_state);
+  decisions   = malloc(var_count*sizeof(Var*));
+  trail_start = malloc(var_count*sizeof(c2dSize));
+  depth       = 0;
+
+  if(sat_unit_resolution(sat_state)) ret = search(restart_unit,flips,vivify_budget,delete,sat_state);
+  while(depth > 0) undo_decision(sat_state);
   sat_undo_unit_resolution(sat_state); // everything goes back to the initial state
+
+  free(decisions);
+  free(trail_start);
+  free_decisions();
   return ret;
 }
 
 int main(int argc, char* argv[]) {
-  char USAGE_MSG[] = "Usage: ./sat -c <cnf_file>\n";
+  char USAGE_MSG[] = "Usage: ./sat [-x] [-l <flips>] [-j <levels>] [-r <conflicts>] [-i <propagations>] [-d <conflicts>] -c <cnf_file>\n"
+                     "  -x  recover XOR constraints from the cnf and propagate them by Gaussian elimination\n"
+                     "  -l  run local search (ProbSAT) for up to <flips> flips before clause learning search,\n"
+                     "      whose best assignment then decides the values of decisions (and, with -r, for a\n"
+                     "      tenth of <flips> flips every 16 restarts, from the saved values of variables)\n"
+                     "  -j  backtrack chronologically (one level) when a learned clause would backjump over more than <levels> levels\n"
+                     "  -r  restart after a Luby sequence of <conflicts> conflicts (keeping the decisions that would be made again)\n"
+                     "  -i  vivify learned clauses periodically, with a budget of <propagations> implied literals per round\n"
+                     "  -d  delete the older half of long learned clauses after <conflicts> conflicts, then at growing intervals\n";
   char* cnf_fname  = NULL;
+  BOOLEAN xors     = 0;
+  c2dSize flips    = 0;
+  c2dSize levels   = 0;
+  c2dSize restarts = 0;
+  c2dSize budget   = 0;
+  c2dSize delete   = 0;
 
-  if(argc==3 && strcmp("-c",argv[1])==0) cnf_fname = argv[2];
-  else {
+  for(int i=1; i<argc; i++) {
+    if(strcmp("-c",argv[i])==0 && i+1<argc) cnf_fname = argv[++i];
+    else if(strcmp("-x",argv[i])==0) xors = 1;
+    else if(strcmp("-l",argv[i])==0 && i+1<argc) flips = strtoul(argv[++i],NULL,10);
+    else if(strcmp("-j",argv[i])==0 && i+1<argc) levels = strtoul(argv[++i],NULL,10);
+    else if(strcmp("-r",argv[i])==0 && i+1<argc) restarts = strtoul(argv[++i],NULL,10);
+    else if(strcmp("-i",argv[i])==0 && i+1<argc) budget = strtoul(argv[++i],NULL,10);
+    else if(strcmp("-d",argv[i])==0 && i+1<argc) delete = strtoul(argv[++i],NULL,10);
+    else {
+      cnf_fname = NULL;
+      break;
+    }
+  }
+  if(cnf_fname==NULL) {
     printf("%s",USAGE_MSG);
     exit(1);
   }
 
   //construct a sat state and then check satisfiability
   SatState* sat_state = sat_state_new(cnf_fname);
-  if(sat(sat_state)) printf("SAT\n");
+  if(xors) sat_recover_xors(sat_state);
+  sat_set_chronological_backtracking(levels,sat_state);
+  if(flips>0 && sat_local_search(flips,1,sat_state)) printf("SAT\n");
+  else if(sat(restarts,flips,budget,delete,sat_state)) printf("SAT\n");
   else printf("UNSAT\n");
   sat_state_free(sat_state);
 